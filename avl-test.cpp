@@ -0,0 +1,444 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <unistd.h>
+#include "avlbst.h"
+
+using namespace std;
+
+/**
+* Checks AVLTree's bulk operations against plain vectors of keys: split
+* and join, the set operations against the std:: set algorithms, and
+* snapshots written by save() and read back by load(). Writes its files
+* to the current directory. Also checks that pooled nodes honor an
+* over-aligned key type.
+*/
+
+typedef AVLTree<int, int> Tree;
+typedef vector<pair<int, int> > Items;
+
+static const string snapshotPath = "avl-test.snapshot";
+
+static int failures = 0;
+
+void report(const char* msg, bool ok)
+{
+    cout << msg << ": " << (ok ? "ok" : "FAILED") << endl;
+    if(!ok) {
+        ++failures;
+    }
+}
+
+/**
+* Reports whether tree is balanced and holds exactly items, in order, and
+* whether its subtree sizes agree with select().
+*/
+bool holdsItems(const Tree& tree, const Items& items)
+{
+    if(!tree.isBalanced() || tree.size() != items.size() || tree.empty() != items.empty()) {
+        return false;
+    }
+    size_t i = 0;
+    for(Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++i) {
+        if(i == items.size() || it->first != items[i].first || it->second != items[i].second) {
+            return false;
+        }
+        if(tree.select(i) != it) {
+            return false;
+        }
+    }
+    return i == items.size();
+}
+
+/**
+* holdsItems() for keys, each with value key * 10.
+*/
+bool holds(const Tree& tree, const vector<int>& keys)
+{
+    Items items;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        items.push_back(make_pair(keys[i], keys[i] * 10));
+    }
+    return holdsItems(tree, items);
+}
+
+bool keyLess(const pair<int, int>& a, const pair<int, int>& b)
+{
+    return a.first < b.first;
+}
+
+/**
+* n distinct random keys below range, sorted, each with value key * 10 +
+* tag; tag tells which input a surviving item came from.
+*/
+Items randomItems(mt19937& rng, size_t n, int range, int tag)
+{
+    vector<int> keys;
+    for(int key = 0; key < range; ++key) {
+        keys.push_back(key);
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+    keys.resize(n);
+    sort(keys.begin(), keys.end());
+    Items items;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        items.push_back(make_pair(keys[i], keys[i] * 10 + tag));
+    }
+    return items;
+}
+
+/**
+* Runs each set operation on random trees of sizes aSize and bSize, with
+* keys drawn from range so that they overlap in part, and compares the
+* result with the std:: algorithm, which like the tree keeps the first
+* input's item on a shared key.
+*/
+bool setOperations(mt19937& rng, size_t aSize, size_t bSize, int range)
+{
+    Items a = randomItems(rng, aSize, range, 0);
+    Items b = randomItems(rng, bSize, range, 1);
+    for(int op = 0; op < 3; ++op) {
+        Tree tree;
+        Tree other;
+        // Random insertion order, so the shapes come from rebalancing
+        Items shuffled = a;
+        shuffle(shuffled.begin(), shuffled.end(), rng);
+        for(size_t i = 0; i < shuffled.size(); ++i) {
+            tree.insert(shuffled[i]);
+        }
+        shuffled = b;
+        shuffle(shuffled.begin(), shuffled.end(), rng);
+        for(size_t i = 0; i < shuffled.size(); ++i) {
+            other.insert(shuffled[i]);
+        }
+
+        Items expected;
+        if(op == 0) {
+            tree.unionWith(other);
+            set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected), keyLess);
+        }
+        else if(op == 1) {
+            tree.intersectWith(other);
+            set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected), keyLess);
+        }
+        else {
+            tree.differenceWith(other);
+            set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(expected), keyLess);
+        }
+        if(!holdsItems(tree, expected) || !other.empty()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* A tree of the given keys, inserted in order so that its shape comes
+* from rebalancing rather than from a bulk build.
+*/
+void fill(Tree& tree, const vector<int>& keys)
+{
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i] * 10));
+    }
+}
+
+vector<int> evenKeys(int from, int to)
+{
+    vector<int> keys;
+    for(int key = from; key < to; key += 2) {
+        keys.push_back(key);
+    }
+    return keys;
+}
+
+/**
+* Splits a tree of n even keys at every key and every gap, including
+* before the first and after the last, then joins the halves back.
+*/
+bool splitEverywhere(int n)
+{
+    vector<int> keys = evenKeys(0, 2 * n);
+    for(int pivot = -1; pivot <= 2 * n; ++pivot) {
+        Tree left;
+        Tree right;
+        fill(left, keys);
+        left.split(pivot, right);
+        vector<int> below;
+        vector<int> above;
+        for(size_t i = 0; i < keys.size(); ++i) {
+            (keys[i] < pivot ? below : above).push_back(keys[i]);
+        }
+        if(!holds(left, below) || !holds(right, above)) {
+            return false;
+        }
+        left.join(right);
+        if(!holds(left, keys) || !holds(right, vector<int>())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+* Joins a tree of leftSize keys, a pivot and a tree of rightSize keys.
+* Sizes far apart give heights far apart.
+*/
+bool joinSizes(int leftSize, int rightSize)
+{
+    vector<int> lowKeys = evenKeys(0, 2 * leftSize);
+    vector<int> highKeys = evenKeys(2 * leftSize + 2, 2 * (leftSize + rightSize) + 2);
+    Tree left;
+    Tree right;
+    fill(left, lowKeys);
+    fill(right, highKeys);
+    left.join(make_pair(2 * leftSize, 2 * leftSize * 10), right);
+
+    vector<int> all = lowKeys;
+    all.push_back(2 * leftSize);
+    all.insert(all.end(), highKeys.begin(), highKeys.end());
+    return holds(left, all) && holds(right, vector<int>());
+}
+
+/**
+* Saves a tree of n even keys and loads it into a tree holding other
+* items, which the load must replace.
+*/
+bool roundTrip(int n)
+{
+    Tree saved;
+    fill(saved, evenKeys(0, 2 * n));
+    saved.save(snapshotPath);
+    Tree loaded;
+    fill(loaded, evenKeys(1, 21));
+    loaded.load(snapshotPath);
+    return holds(loaded, evenKeys(0, 2 * n)) && ::access((snapshotPath + ".tmp").c_str(), F_OK) != 0;
+}
+
+/**
+* Reports whether loading path into a tree of 3 items throws
+* std::runtime_error and leaves those items in place.
+*/
+bool loadFails(const string& path)
+{
+    Tree tree;
+    fill(tree, evenKeys(100, 106));
+    try {
+        tree.load(path);
+    }
+    catch(const runtime_error&) {
+        return holds(tree, evenKeys(100, 106));
+    }
+    return false;
+}
+
+/**
+* Cuts the file at path to its first size bytes.
+*/
+void truncateFile(const string& path, size_t size)
+{
+    vector<char> bytes;
+    {
+        ifstream in(path.c_str(), ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    bytes.resize(min(size, bytes.size()));
+    ofstream out(path.c_str(), ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+/**
+* A key aligned past alignof(std::max_align_t), as for a key padded out
+* to a cache line.
+*/
+struct alignas(64) WideKey
+{
+    int key;
+    bool operator<(const WideKey& other) const { return key < other.key; }
+};
+
+// For the tree's print()
+ostream& operator<<(ostream& out, const WideKey& key)
+{
+    return out << key.key;
+}
+
+/**
+* Reports whether fn throws std::invalid_argument.
+*/
+template<typename Fn>
+bool rejects(Fn fn)
+{
+    try {
+        fn();
+    }
+    catch(const invalid_argument&) {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    // Split at every position, for every size up to where the tree has
+    // a few levels, then at a size with many
+    bool ok = true;
+    for(int n = 0; n <= 40 && ok; ++n) {
+        ok = splitEverywhere(n);
+    }
+    report("split and rejoin at every position, n <= 40", ok);
+    report("split and rejoin at every position, n = 300", splitEverywhere(300));
+
+    // Joins of trees whose heights differ by 0, 1 and many levels, on
+    // either side, including empty ones
+    int sizes[] = { 0, 1, 2, 3, 7, 12, 100, 1000, 5000 };
+    ok = true;
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        for(size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); ++j) {
+            ok = ok && joinSizes(sizes[i], sizes[j]);
+        }
+    }
+    report("join with a pivot across height gaps", ok);
+
+    // The pivotless join of a short tree to a tall one, both ways
+    {
+        Tree small;
+        Tree large;
+        fill(small, evenKeys(0, 6));
+        fill(large, evenKeys(6, 4006));
+        small.join(large);
+        report("join of a short tree to a tall one", holds(small, evenKeys(0, 4006)) && large.empty());
+
+        Tree large2;
+        Tree small2;
+        fill(large2, evenKeys(0, 4000));
+        fill(small2, evenKeys(4000, 4004));
+        large2.join(small2);
+        report("join of a tall tree to a short one", holds(large2, evenKeys(0, 4004)) && small2.empty());
+    }
+
+    // Bad arguments are rejected and leave both trees as they were
+    {
+        vector<int> lowKeys = evenKeys(0, 20);
+        vector<int> highKeys = evenKeys(20, 40);
+        Tree low;
+        Tree high;
+        fill(low, lowKeys);
+        fill(high, highKeys);
+
+        report("split into a non-empty tree", rejects([&]() { low.split(10, high); }));
+        report("split into itself", rejects([&]() { low.split(10, low); }));
+        report("join to itself", rejects([&]() { low.join(low); }));
+        report("join with a pivot to itself", rejects([&]() { low.join(make_pair(100, 1000), low); }));
+        report("join with a pivot below the left keys",
+            rejects([&]() { low.join(make_pair(10, 100), high); }));
+        report("join with a pivot above the right keys",
+            rejects([&]() { low.join(make_pair(30, 300), high); }));
+        report("join with a pivot equal to a key", rejects([&]() { low.join(make_pair(20, 200), high); }));
+        report("join of overlapping trees", rejects([&]() { high.join(low); }));
+        report("trees untouched by rejected calls", holds(low, lowKeys) && holds(high, highKeys));
+    }
+
+    // Set operations below and above AVL_SET_OPERATION_GRAIN, where they
+    // start running on several threads, with sparse and dense overlap
+    {
+        mt19937 rng(12);
+        size_t small[][2] = { { 0, 0 }, { 0, 50 }, { 50, 0 }, { 1, 1 }, { 100, 30 }, { 30, 100 }, { 1500, 1500 } };
+        ok = true;
+        for(size_t i = 0; i < sizeof(small) / sizeof(small[0]); ++i) {
+            ok = ok && setOperations(rng, small[i][0], small[i][1], 4000)
+                && setOperations(rng, small[i][0], small[i][1], 2 * int(max(small[i][0], small[i][1])) + 1);
+        }
+        report("set operations below the grain", ok);
+
+        size_t large[][2] = { { 20000, 20000 }, { 50000, 500 }, { 500, 50000 }, { 4096, 1 } };
+        ok = true;
+        for(size_t i = 0; i < sizeof(large) / sizeof(large[0]); ++i) {
+            ok = ok && setOperations(rng, large[i][0], large[i][1], 200000)
+                && setOperations(rng, large[i][0], large[i][1], int(max(large[i][0], large[i][1])) + 1000);
+        }
+        report("set operations above the grain", ok);
+    }
+
+    // A tree combined with itself
+    {
+        Tree tree;
+        fill(tree, evenKeys(0, 100));
+        tree.unionWith(tree);
+        ok = holds(tree, evenKeys(0, 100));
+        tree.intersectWith(tree);
+        ok = ok && holds(tree, evenKeys(0, 100));
+        tree.differenceWith(tree);
+        report("set operations of a tree with itself", ok && holds(tree, vector<int>()));
+    }
+
+    // Snapshots round-trip at every size class, through load() into a
+    // tree that held other items
+    report("save and load of an empty tree", roundTrip(0));
+    report("save and load of one item", roundTrip(1));
+    report("save and load of 100000 items", roundTrip(100000));
+
+    // Bad snapshots are rejected and leave the loading tree as it was
+    {
+        Tree saved;
+        fill(saved, evenKeys(0, 2000));
+        saved.save(snapshotPath);
+        report("load of a missing file", loadFails(snapshotPath + ".missing"));
+
+        AVLTree<int64_t, int> wideKeys;
+        wideKeys.insert(make_pair(int64_t(1), 1));
+        wideKeys.save(snapshotPath);
+        report("load of another key size", loadFails(snapshotPath));
+
+        AVLTree<int, int64_t> wideValues;
+        wideValues.insert(make_pair(1, int64_t(1)));
+        wideValues.save(snapshotPath);
+        report("load of another value size", loadFails(snapshotPath));
+
+        // Same sizes, opposite order: the keys arrive descending
+        AVLTree<int, int, greater<int> > reversed;
+        for(int key = 0; key < 100; ++key) {
+            reversed.insert(make_pair(key, key * 10));
+        }
+        reversed.save(snapshotPath);
+        report("load of a snapshot in another key order", loadFails(snapshotPath));
+
+        saved.save(snapshotPath);
+        truncateFile(snapshotPath, sizeof(AVLSnapshotHeader) + 500 * 2 * sizeof(int) + 3);
+        report("load of a snapshot cut mid-item", loadFails(snapshotPath));
+        truncateFile(snapshotPath, sizeof(AVLSnapshotHeader));
+        report("load of a snapshot cut after its header", loadFails(snapshotPath));
+        truncateFile(snapshotPath, sizeof(AVLSnapshotHeader) - 1);
+        report("load of a snapshot cut inside its header", loadFails(snapshotPath));
+
+        {
+            ofstream out(snapshotPath.c_str(), ios::binary | ios::trunc);
+            out << "not a snapshot, but long enough to hold a header";
+        }
+        report("load of a file of another format", loadFails(snapshotPath));
+        remove(snapshotPath.c_str());
+    }
+
+    // Enough nodes to fill several pool chunks
+    {
+        AVLTree<WideKey, int> tree;
+        for(int i = 0; i < 5000; ++i) {
+            WideKey key = { i };
+            tree.insert(make_pair(key, i));
+        }
+        ok = tree.isBalanced();
+        for(AVLTree<WideKey, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            ok = ok && reinterpret_cast<uintptr_t>(&it->first) % alignof(WideKey) == 0;
+        }
+        report("nodes of an over-aligned key are aligned", ok);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -6,7 +6,18 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <type_traits>
+#include <future>
+#include <thread>
 #include "bst.h"
+#include "file_sync.h"
 
 struct KeyError { };
 
@@ -21,22 +32,29 @@ class AVLNode : public Node<Key, Value>
 public:
     // Constructor/destructor.
     AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    template<typename... Args>
+    AVLNode(AVLNode<Key, Value>* parent, Args&&... args);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
-    // Getters for parent, left, and right. These need to be redefined since they
+    // Getter/setter for the number of nodes in the subtree rooted here.
+    size_t getSize () const;
+    void setSize (size_t size);
+
+    // Getters for parent, left, and right. These hide the Node versions since they
     // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
     // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
     int8_t balance_;    // effectively a signed char
+    size_t size_;       // nodes in this subtree, including this one
 };
 
 /*
@@ -50,7 +68,18 @@ protected:
 */
 template<class Key, class Value>
 AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+    Node<Key, Value>(key, value, parent), balance_(0), size_(1)
+{
+
+}
+
+/**
+* In-place constructor, forwarding the item's constructor arguments to Node.
+*/
+template<class Key, class Value>
+template<typename... Args>
+AVLNode<Key, Value>::AVLNode(AVLNode<Key, Value> *parent, Args&&... args) :
+    Node<Key, Value>(parent, std::forward<Args>(args)...), balance_(0), size_(1)
 {
 
 }
@@ -92,8 +121,26 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
-* that our node is a AVLNode.
+* A getter for the subtree size of a AVLNode.
+*/
+template<class Key, class Value>
+size_t AVLNode<Key, Value>::getSize() const
+{
+    return size_;
+}
+
+/**
+* A setter for the subtree size of a AVLNode.
+*/
+template<class Key, class Value>
+void AVLNode<Key, Value>::setSize(size_t size)
+{
+    size_ = size;
+}
+
+/**
+* A getter for the parent that hides Node::getParent(), since a static_cast is necessary to make sure
+* that our node is a AVLNode. Resolved at compile time, so it inlines to a single load.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
@@ -102,7 +149,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
@@ -111,7 +158,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
@@ -127,12 +174,127 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+// Below this many nodes in play a set operation stops forking threads.
+static const size_t AVL_SET_OPERATION_GRAIN = 4096;
+
+/**
+* The start of a file written by AVLTree::save(): a magic number (which
+* also tells a file written with the other byte order apart), the format
+* version, the sizes of Key and Value, and the number of items. The items
+* follow in key order, each as the bytes of its key then of its value.
+*/
+struct AVLSnapshotHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint64_t count;
+};
+
+static const uint32_t AVL_SNAPSHOT_MAGIC = 0x534c5641;     // "AVLS" when stored little-endian
+static const uint32_t AVL_SNAPSHOT_VERSION = 1;
+// Snapshot files are read and written this many bytes at a time.
+static const size_t AVL_SNAPSHOT_BLOCK = 1 << 16;
+
+/**
+* Hands out the items of a snapshot one at a time, reading them from the
+* stream a block at a time and never past the last of count items.
+*/
+class AVLSnapshotReader
 {
 public:
+    AVLSnapshotReader(std::istream& in, size_t itemBytes, uint64_t count) :
+        in_(in), itemBytes_(itemBytes), left_(count),
+        block_(std::max<size_t>(1, AVL_SNAPSHOT_BLOCK / itemBytes) * itemBytes), pos_(0), end_(0)
+    {
+
+    }
+
+    /**
+    * Returns the bytes of the next item; throws std::runtime_error if the
+    * file ends first.
+    */
+    const char* next()
+    {
+        if (pos_ == end_){
+            uint64_t items = std::min<uint64_t>(left_, block_.size() / itemBytes_);
+            end_ = static_cast<size_t>(items) * itemBytes_;
+            pos_ = 0;
+            if (items == 0 || !in_.read(&block_[0], end_)){
+                throw std::runtime_error("load: snapshot is truncated");
+            }
+            left_ -= items;
+        }
+        const char* item = &block_[pos_];
+        pos_ += itemBytes_;
+        return item;
+    }
+
+private:
+    std::istream& in_;
+    size_t itemBytes_;
+    uint64_t left_;
+    std::vector<char> block_;
+    size_t pos_;
+    size_t end_;
+};
+
+template <class Key, class Value, class Compare = std::less<Key> >
+class AVLTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    AVLTree();
+    explicit AVLTree(const Compare& comp);
+    template<typename ForwardIt>
+    AVLTree(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    virtual ~AVLTree();
+    template<typename ForwardIt>
+    void assignSorted(ForwardIt first, ForwardIt last);
+    // Binary snapshots of trees whose Key and Value are trivially copyable
+    void save(const std::string& path, bool durable = false) const;
+    void load(const std::string& path);
     virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    virtual void insert (std::pair<const Key, Value> &&new_item);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> tryEmplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> tryEmplace(Key&& key, Args&&... args);
+
+    // Locate-or-create in one descent; rebalancing happens only on a miss
+    template<typename Fn>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> upsert(const Key& key, Fn fn);
+    template<typename Fn>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> upsert(Key&& key, Fn fn);
+    template<typename V>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> insertOrAssign(const Key& key, V&& value);
+    template<typename V>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> insertOrAssign(Key&& key, V&& value);
+    Value& findOrInsert(const Key& key);
+    Value& findOrInsert(Key&& key);
     virtual void remove(const Key& key);  // TODO
+    virtual int height() const;
+
+    // Re-partitioning in O(log n); nodes move between trees without copying
+    void split(const Key& key, AVLTree& right);
+    void join(const std::pair<const Key, Value>& pivot, AVLTree& right);
+    void join(AVLTree& right);
+
+    // Bulk set operations on keys, consuming other; this tree's value wins
+    // on a shared key. Large inputs are processed on several threads.
+    void unionWith(AVLTree& other);
+    void intersectWith(AVLTree& other);
+    void differenceWith(AVLTree& other);
+
+    // Order statistics, all O(log n) using the subtree sizes kept in each AVLNode
+    size_t size() const;
+    size_t rank(const Key& key) const;
+    virtual size_t countRange(const Key& lo, const Key& hi) const;
+    typename BinarySearchTree<Key, Value, Compare>::iterator select(size_t k) const;
+    typename BinarySearchTree<Key, Value, Compare>::iterator advance(
+        typename BinarySearchTree<Key, Value, Compare>::iterator it, size_t k) const;
 protected:
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
 
@@ -141,93 +303,915 @@ protected:
     void leftRotate(AVLNode<Key, Value>* n1, AVLNode<Key,Value>* n2);
 		void insertFix(AVLNode<Key,Value>* curr, AVLNode<Key,Value>* parent, AVLNode<Key,Value>* grandp);
     void removeFix(AVLNode<Key,Value>* n, int diff);
+    AVLNode<Key,Value>* createNode(const Key& key, const Value& value, AVLNode<Key,Value>* parent);
+    virtual void destroyNode(Node<Key,Value>* node);
+    virtual void afterInsert(Node<Key,Value>* node);
+    bool growFix(AVLNode<Key,Value>* node);
+    AVLNode<Key,Value>* joinNodes(AVLNode<Key,Value>* left, int leftHeight, AVLNode<Key,Value>* mid,
+        AVLNode<Key,Value>* right, int rightHeight, int& height);
+    void splitNode(AVLNode<Key,Value>* node, int height, const Key& key, AVLNode<Key,Value>*& left,
+        int& leftHeight, AVLNode<Key,Value>*& match, AVLNode<Key,Value>*& right, int& rightHeight);
+    AVLNode<Key,Value>* joinNodes(AVLNode<Key,Value>* left, int leftHeight,
+        AVLNode<Key,Value>* right, int rightHeight, int& height);
+    AVLNode<Key,Value>* splitLast(AVLNode<Key,Value>* node, int height, int& restHeight, AVLNode<Key,Value>*& last);
+
+    enum SetOperation { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+    void applySetOperation(SetOperation op, AVLTree& other);
+    AVLNode<Key,Value>* setOperationNodes(SetOperation op, AVLNode<Key,Value>* a, int aHeight,
+        AVLNode<Key,Value>* b, int bHeight, int forkDepth, std::vector<AVLNode<Key,Value>*>& discarded, int& height);
+    static void collectNodes(AVLNode<Key,Value>* node, std::vector<AVLNode<Key,Value>*>& nodes);
+    static int setOperationForkDepth();
+    size_t countBelow(const Key& key, bool inclusive) const;
+    static size_t subtreeSize(AVLNode<Key,Value>* node);
+    static void updateSize(AVLNode<Key,Value>* node);
+    static void addToAncestorSizes(AVLNode<Key,Value>* node, std::ptrdiff_t delta);
+    template<typename ForwardIt>
+    AVLNode<Key,Value>* buildSorted(ForwardIt& it, ForwardIt last, size_t n, int& height);
+    AVLNode<Key,Value>* buildLoaded(AVLSnapshotReader& reader, uint64_t n, AVLNode<Key,Value>*& last, int& height);
 
 
 };
 
+/**
+* Default constructor; sizes the node pool for AVLNodes.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::AVLTree() :
+    BinarySearchTree<Key, Value, Compare>(sizeof(AVLNode<Key, Value>), alignof(AVLNode<Key, Value>))
+{
+
+}
+
+/**
+* Constructor for a tree ordered by the given comparator object.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::AVLTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(sizeof(AVLNode<Key, Value>), alignof(AVLNode<Key, Value>), comp)
+{
+
+}
+
+/**
+* Builds a tree from a range sorted by key, see assignSorted().
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+AVLTree<Key, Value, Compare>::AVLTree(ForwardIt first, ForwardIt last, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(sizeof(AVLNode<Key, Value>), alignof(AVLNode<Key, Value>), comp)
+{
+	assignSorted(first, last);
+}
+
+/**
+* Destructor; clears here so that destroyNode() still dispatches to the AVL version.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::~AVLTree()
+{
+	this->clear();
+}
+
+/**
+* Builds an AVLNode in a block taken from the tree's pool.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent)
+{
+	return this->template constructNode<AVLNode<Key, Value> >(parent, key, value);
+}
+
+/**
+* Runs the AVLNode destructor before returning the block to the pool.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+	static_cast<AVLNode<Key, Value>*>(node)->~AVLNode();
+	this->pool_->deallocate(node);
+}
+
+/**
+* Replaces the contents of the tree with the key/value pairs in [first, last),
+* which must be sorted by key. Runs of equal keys keep the last value, as if
+* the pairs had been inserted one by one. One pass counts and checks the input,
+* a second creates each node exactly once in its final, height-balanced place,
+* so the whole build is linear and performs no rotations.
+* Throws std::invalid_argument (leaving the tree untouched) if the range is unsorted.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+void AVLTree<Key, Value, Compare>::assignSorted(ForwardIt first, ForwardIt last)
+{
+	size_t n = 0;
+	for (ForwardIt it = first; it != last; ){
+		ForwardIt next = it;
+		++next;
+		if (next != last && this->comp_(next->first, it->first)){
+			throw std::invalid_argument("assignSorted: range is not sorted by key");
+		}
+		if (next == last || this->comp_(it->first, next->first)){
+			++n;
+		}
+		it = next;
+	}
+
+	this->clear();
+	int height = 0;
+	ForwardIt it = first;
+	this->root_ = buildSorted(it, last, n, height);
+}
+
+/**
+* Builds a balanced subtree out of the next n distinct keys of the range,
+* advancing it past them. Sets height to the height of the new subtree so
+* the caller can derive its own balance without revisiting children.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::buildSorted(ForwardIt& it, ForwardIt last, size_t n, int& height)
+{
+	if (n == 0){
+		height = 0;
+		return nullptr;
+	}
+
+	int leftHeight = 0;
+	int rightHeight = 0;
+	AVLNode<Key, Value>* left = buildSorted(it, last, (n - 1) / 2, leftHeight);
+
+	// skip to the last pair of a run of equal keys
+	ForwardIt next = it;
+	++next;
+	while (next != last && !this->comp_(it->first, next->first)){
+		it = next;
+		++next;
+	}
+	AVLNode<Key, Value>* curr = createNode(it->first, it->second, nullptr);
+	it = next;
+
+	AVLNode<Key, Value>* right = buildSorted(it, last, n - 1 - (n - 1) / 2, rightHeight);
+
+	curr->setLeft(left);
+	curr->setRight(right);
+	if (left != nullptr){
+		left->setParent(curr);
+	}
+	if (right != nullptr){
+		right->setParent(curr);
+	}
+	curr->setBalance(rightHeight - leftHeight);
+	curr->setSize(n);
+	height = 1 + std::max(leftHeight, rightHeight);
+	return curr;
+}
+
+/**
+* Writes every item, in key order, to a snapshot file at path (see
+* AVLSnapshotHeader), a block at a time. The file is written as path.tmp
+* and renamed over path once complete, so a save that fails part way
+* leaves any earlier snapshot in place. With durable set, path.tmp is
+* fsync()ed before the rename and the directory after it, so a crash
+* leaves either the old snapshot or the whole new one on disk. Throws
+* std::runtime_error if the file cannot be written.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::save(const std::string& path, bool durable) const
+{
+	static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+		"save() stores keys and values as raw bytes");
+	std::string tmpPath = path + ".tmp";
+	std::ofstream out(tmpPath.c_str(), std::ios::binary | std::ios::trunc);
+	if (!out){
+		throw std::runtime_error("save: cannot open " + tmpPath);
+	}
+
+	AVLSnapshotHeader header;
+	header.magic = AVL_SNAPSHOT_MAGIC;
+	header.version = AVL_SNAPSHOT_VERSION;
+	header.keySize = sizeof(Key);
+	header.valueSize = sizeof(Value);
+	header.count = size();
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	const size_t itemBytes = sizeof(Key) + sizeof(Value);
+	std::vector<char> block(std::max<size_t>(1, AVL_SNAPSHOT_BLOCK / itemBytes) * itemBytes);
+	size_t used = 0;
+	for (Node<Key, Value>* curr = this->getSmallestNode(); curr != nullptr;
+		curr = BinarySearchTree<Key, Value, Compare>::successor(curr)){
+		std::memcpy(&block[used], &curr->getKey(), sizeof(Key));
+		std::memcpy(&block[used + sizeof(Key)], &curr->getValue(), sizeof(Value));
+		used += itemBytes;
+		if (used == block.size()){
+			out.write(&block[0], used);
+			used = 0;
+		}
+	}
+	out.write(&block[0], used);
+	out.close();
+	if (!out){
+		std::remove(tmpPath.c_str());
+		throw std::runtime_error("save: cannot write " + path);
+	}
+	if (durable){
+		try {
+			syncFile(tmpPath);
+		}
+		catch (const std::runtime_error&) {
+			std::remove(tmpPath.c_str());
+			throw;
+		}
+	}
+	if (std::rename(tmpPath.c_str(), path.c_str()) != 0){
+		std::remove(tmpPath.c_str());
+		throw std::runtime_error("save: cannot write " + path);
+	}
+	if (durable){
+		syncDirectory(path);
+	}
+}
+
+/**
+* Replaces the contents of the tree with a snapshot written by save().
+* Like assignSorted(), it creates each node once, in its final place in a
+* height-balanced shape, so loading is linear, makes no rotations and
+* reads the file in a single pass. Throws std::runtime_error, leaving the
+* tree untouched, if the file is missing, truncated, of another format
+* version or Key/Value size, or not in this tree's key order.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::load(const std::string& path)
+{
+	static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+		"load() restores keys and values from raw bytes");
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in){
+		throw std::runtime_error("load: cannot open " + path);
+	}
+	AVLSnapshotHeader header;
+	if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != AVL_SNAPSHOT_MAGIC){
+		throw std::runtime_error("load: " + path + " is not an AVLTree snapshot");
+	}
+	if (header.version != AVL_SNAPSHOT_VERSION){
+		throw std::runtime_error("load: unsupported snapshot version in " + path);
+	}
+	if (header.keySize != sizeof(Key) || header.valueSize != sizeof(Value)){
+		throw std::runtime_error("load: key or value size in " + path + " does not match this tree");
+	}
+
+	// Build on the side, so a bad file leaves this tree as it was; the
+	// nodes of a half-built tree need no destructor and go with its pool.
+	AVLTree<Key, Value, Compare> loaded(this->comp_);
+	AVLSnapshotReader reader(in, sizeof(Key) + sizeof(Value), header.count);
+	AVLNode<Key, Value>* last = nullptr;
+	int height = 0;
+	loaded.root_ = loaded.buildLoaded(reader, header.count, last, height);
+
+	this->clear();
+	std::swap(this->root_, loaded.root_);
+	std::swap(this->pool_, loaded.pool_);
+}
+
+/**
+* buildSorted() for the next n items of a snapshot. last is the node built
+* just before, whose key each new one must follow.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::buildLoaded(AVLSnapshotReader& reader, uint64_t n,
+	AVLNode<Key, Value>*& last, int& height)
+{
+	if (n == 0){
+		height = 0;
+		return nullptr;
+	}
+
+	int leftHeight = 0;
+	int rightHeight = 0;
+	AVLNode<Key, Value>* left = buildLoaded(reader, (n - 1) / 2, last, leftHeight);
+
+	const char* item = reader.next();
+	typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keyBytes;
+	typename std::aligned_storage<sizeof(Value), alignof(Value)>::type valueBytes;
+	std::memcpy(&keyBytes, item, sizeof(Key));
+	std::memcpy(&valueBytes, item + sizeof(Key), sizeof(Value));
+	const Key& key = *reinterpret_cast<const Key*>(&keyBytes);
+	if (last != nullptr && !this->comp_(last->getKey(), key)){
+		throw std::runtime_error("load: snapshot keys are out of order");
+	}
+	AVLNode<Key, Value>* curr = createNode(key, *reinterpret_cast<const Value*>(&valueBytes), nullptr);
+	last = curr;
+
+	AVLNode<Key, Value>* right = buildLoaded(reader, n - 1 - (n - 1) / 2, last, rightHeight);
+
+	curr->setLeft(left);
+	curr->setRight(right);
+	if (left != nullptr){
+		left->setParent(curr);
+	}
+	if (right != nullptr){
+		right->setParent(curr);
+	}
+	curr->setBalance(rightHeight - leftHeight);
+	curr->setSize(n);
+	height = 1 + std::max(leftHeight, rightHeight);
+	return curr;
+}
+
 /*
  * Recall: If key is already in the tree, you should 
  * overwrite the current value with the updated value.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::insert (const std::pair<const Key, Value> &new_item)
 {
-	Key key_ = new_item.first;
-	Value value_ = new_item.second;
-	AVLNode<Key, Value>* curr = static_cast<AVLNode<Key,Value>*>(this->root_);
-	AVLNode<Key, Value>* parent = nullptr;
-	bool left_ = false;
+	this->template insertItem<AVLNode<Key, Value> >(new_item);
+}
+
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::insert (std::pair<const Key, Value> &&new_item)
+{
+	this->template insertItem<AVLNode<Key, Value> >(std::move(new_item));
+}
+
+/**
+* Same as BinarySearchTree::emplace(), but builds an AVLNode and
+* rebalances when a node is actually added.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+	return this->template emplaceItem<AVLNode<Key, Value> >(std::forward<Args>(args)...);
+}
 
-	if (this -> root_ == NULL){
-		this->root_ = new AVLNode<Key,Value>(key_,value_,nullptr);
-    return;
+/**
+* Same as BinarySearchTree::tryEmplace(), building an AVLNode.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare>::tryEmplace(const Key& key, Args&&... args)
+{
+	return this->template tryEmplaceItem<AVLNode<Key, Value> >(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare>::tryEmplace(Key&& key, Args&&... args)
+{
+	return this->template tryEmplaceItem<AVLNode<Key, Value> >(std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Finds key, adding it with a value-initialized Value if absent, then
+* calls fn on the stored value so it can be updated in place. Returns the
+* item's position and whether it was created.
+*/
+template<class Key, class Value, class Compare>
+template<typename Fn>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare>::upsert(const Key& key, Fn fn)
+{
+	std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> result = tryEmplace(key);
+	fn(result.first->second);
+	return result;
+}
+
+template<class Key, class Value, class Compare>
+template<typename Fn>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare>::upsert(Key&& key, Fn fn)
+{
+	std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> result = tryEmplace(std::move(key));
+	fn(result.first->second);
+	return result;
+}
+
+/**
+* Assigns value to key's entry, or inserts it if key is absent.
+* Unlike insert(), reports where the item is and whether it was created.
+*/
+template<class Key, class Value, class Compare>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare>::insertOrAssign(const Key& key, V&& value)
+{
+	std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> result =
+		tryEmplace(key, std::forward<V>(value));
+	if (!result.second){
+		// tryEmplace() leaves its arguments alone on a hit
+		result.first->second = std::forward<V>(value);
 	}
-	else{
-		while (curr != NULL){
-			Key currKey = curr -> getKey();
-			parent = curr;
-			
-			if (key_ < currKey){
-				curr = curr->getLeft();
-				left_ = true;
-			}
-			else if (key_ > currKey){
-				curr = curr->getRight();
-				left_ = false;
-			}
-			else if (key_ == currKey){
-				curr->setValue(value_);
-				return;
-			}
+	return result;
+}
+
+template<class Key, class Value, class Compare>
+template<typename V>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+AVLTree<Key, Value, Compare>::insertOrAssign(Key&& key, V&& value)
+{
+	std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> result =
+		tryEmplace(std::move(key), std::forward<V>(value));
+	if (!result.second){
+		result.first->second = std::forward<V>(value);
+	}
+	return result;
+}
+
+/**
+* Like operator[], but a missing key is inserted with a value-initialized
+* Value instead of throwing std::out_of_range.
+*/
+template<class Key, class Value, class Compare>
+Value& AVLTree<Key, Value, Compare>::findOrInsert(const Key& key)
+{
+	return tryEmplace(key).first->second;
+}
+
+template<class Key, class Value, class Compare>
+Value& AVLTree<Key, Value, Compare>::findOrInsert(Key&& key)
+{
+	return tryEmplace(std::move(key)).first->second;
+}
+
+/**
+* Restores sizes and balance after a new leaf has been linked in,
+* walking up until a subtree's height stops changing or a rotation fixes it.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
+{
+	AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(node);
+	addToAncestorSizes(curr, 1);
+	growFix(curr);
+}
+
+/**
+* Fixes balance factors after node's subtree got one level taller, walking
+* up until some subtree's height stops changing or a rotation fixes it.
+* Returns true if the whole tree above node grew as well.
+*/
+template<class Key, class Value, class Compare>
+bool AVLTree<Key, Value, Compare>::growFix(AVLNode<Key, Value>* node)
+{
+	AVLNode<Key, Value>* curr = node;
+	AVLNode<Key, Value>* parent = curr->getParent();
+
+	while(parent != nullptr){
+		if (parent -> getLeft() == curr){
+			parent -> updateBalance(-1);
+		}
+		else{
+			parent -> updateBalance(1);
 		}
 
-		curr = new AVLNode<Key,Value>(key_,value_,parent);
-		if (left_ == true){
-			parent -> setLeft(curr);
+		if (parent -> getBalance() == 0){
+			return false;
 		}
-		else if (left_ == false){
-			parent -> setRight(curr);
+		else if (parent->getBalance() == 2 || parent->getBalance() == -2){
+			// curr is the taller side of parent; rotate through its taller child
+			AVLNode<Key, Value>* child = (curr->getBalance() < 0) ? curr->getLeft() : curr->getRight();
+			insertFix(child, curr, parent);
+			return false;
 		}
+		curr = parent;
+		parent = parent -> getParent();
 	}
+	return true;
+}
 
-	if (parent -> getLeft() != curr){
-		parent->updateBalance(1);
+/**
+* Moves every item whose key is not less than key into right, which must be
+* an empty tree with the same ordering. Both trees stay balanced, and the
+* work is O(log n): whole subtrees change hands, only the nodes on the
+* search path for key are relinked.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::split(const Key& key, AVLTree& right)
+{
+	if (&right == this || !right.empty()){
+		throw std::invalid_argument("split target must be a different, empty tree");
 	}
-	else if (parent -> getLeft()==curr){
-		parent->updateBalance(-1);
+	right.adoptPoolsOf(*this);
+
+	AVLNode<Key, Value>* lower;
+	AVLNode<Key, Value>* match;
+	AVLNode<Key, Value>* upper;
+	int lowerHeight, upperHeight;
+	splitNode(static_cast<AVLNode<Key, Value>*>(this->root_), height(), key,
+		lower, lowerHeight, match, upper, upperHeight);
+	if (match != nullptr){
+		upper = joinNodes(nullptr, 0, match, upper, upperHeight, upperHeight);
 	}
+	this->root_ = lower;
+	right.root_ = upper;
+}
 
-	AVLNode<Key, Value>* grandp = parent->getParent();
+/**
+* Appends pivot and then all of right to this tree, leaving right empty.
+* Every key here must be less than pivot's, and pivot's less than every
+* key in right; std::invalid_argument is thrown otherwise. O(log n).
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::join(const std::pair<const Key, Value>& pivot, AVLTree& right)
+{
+	if (&right == this){
+		throw std::invalid_argument("cannot join a tree to itself");
+	}
+	if ((this->root_ != nullptr && !this->comp_(this->getLargestNode()->getKey(), pivot.first)) ||
+		(right.root_ != nullptr && !this->comp_(pivot.first, right.getSmallestNode()->getKey()))){
+		throw std::invalid_argument("join requires left keys < pivot < right keys");
+	}
+	AVLNode<Key, Value>* mid = this->template constructNode<AVLNode<Key, Value> >(nullptr, pivot);
+	this->adoptPoolsOf(right);
 
-	while(grandp != nullptr){
-		if (parent -> getBalance() == 0){
-			return;
+	int joinedHeight;
+	this->root_ = joinNodes(static_cast<AVLNode<Key, Value>*>(this->root_), height(), mid,
+		static_cast<AVLNode<Key, Value>*>(right.root_), right.height(), joinedHeight);
+	right.root_ = nullptr;
+}
+
+/**
+* Appends all of right to this tree, leaving right empty. Right's smallest
+* item becomes the pivot of join() above; the same ordering rule applies,
+* and is checked before that item is taken out of right.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::join(AVLTree& right)
+{
+	if (&right == this){
+		throw std::invalid_argument("cannot join a tree to itself");
+	}
+	if (right.root_ == nullptr){
+		return;
+	}
+	Node<Key, Value>* smallest = right.getSmallestNode();
+	if (this->root_ != nullptr && !this->comp_(this->getLargestNode()->getKey(), smallest->getKey())){
+		throw std::invalid_argument("join requires left keys < right keys");
+	}
+	std::pair<const Key, Value> pivot(smallest->getKey(), std::move(smallest->getValue()));
+	right.remove(pivot.first);
+	join(pivot, right);
+}
+
+/**
+* Links left, mid and right (left's keys < mid's < right's) into one AVL
+* subtree and returns its root; height is set to the result's height. The
+* shorter side is hung off the taller one's inner spine at a matching
+* height, then fixed up as an insertion would be, so the cost is
+* O(|leftHeight - rightHeight| + 1).
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::joinNodes(AVLNode<Key,Value>* left, int leftHeight,
+	AVLNode<Key,Value>* mid, AVLNode<Key,Value>* right, int rightHeight, int& height)
+{
+	if (leftHeight <= rightHeight + 1 && rightHeight <= leftHeight + 1){
+		mid->setLeft(left);
+		mid->setRight(right);
+		mid->setParent(nullptr);
+		if (left != nullptr){
+			left->setParent(mid);
 		}
-		if (grandp -> getLeft() == parent){
-			grandp -> updateBalance(-1);
+		if (right != nullptr){
+			right->setParent(mid);
+		}
+		mid->setBalance(rightHeight - leftHeight);
+		updateSize(mid);
+		height = std::max(leftHeight, rightHeight) + 1;
+		return mid;
+	}
+
+	bool tallLeft = leftHeight > rightHeight;
+	AVLNode<Key, Value>* tall = tallLeft ? left : right;
+	AVLNode<Key, Value>* shortTree = tallLeft ? right : left;
+	int tallHeight = tallLeft ? leftHeight : rightHeight;
+	int shortHeight = tallLeft ? rightHeight : leftHeight;
+
+	// walk tall's inner spine to the first subtree no taller than shortHeight + 1
+	AVLNode<Key, Value>* parent = nullptr;
+	AVLNode<Key, Value>* curr = tall;
+	int currHeight = tallHeight;
+	while (currHeight > shortHeight + 1){
+		parent = curr;
+		if (tallLeft){
+			currHeight -= (curr->getBalance() >= 0) ? 1 : 2;
+			curr = curr->getRight();
 		}
 		else{
-			grandp -> updateBalance(1);
+			currHeight -= (curr->getBalance() <= 0) ? 1 : 2;
+			curr = curr->getLeft();
 		}
+	}
 
-		if (grandp->getBalance()== 2){
-			insertFix(curr,parent,grandp);
-			return;
+	int midHeight;
+	if (tallLeft){
+		joinNodes(curr, currHeight, mid, shortTree, shortHeight, midHeight);
+		parent->setRight(mid);
+	}
+	else{
+		joinNodes(shortTree, shortHeight, mid, curr, currHeight, midHeight);
+		parent->setLeft(mid);
+	}
+	mid->setParent(parent);
+	addToAncestorSizes(mid, subtreeSize(shortTree) + 1);
+
+	// mid is one level taller than the subtree it replaced
+	bool grew = growFix(mid);
+	height = tallHeight + (grew ? 1 : 0);
+
+	// a rotation may have replaced tall as the top; it is at most
+	// tallHeight - currHeight levels above mid
+	AVLNode<Key, Value>* top = mid;
+	while (top->getParent() != nullptr){
+		top = top->getParent();
+	}
+	return top;
+}
+
+/**
+* Splits the subtree at node (of the given height) into the nodes with
+* keys less than key, the node matching key (or NULL), and the rest. The
+* outer pieces come back as detached AVL subtrees with their heights,
+* rebuilt with joinNodes() on the way back up, whose costs telescope to
+* O(height).
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::splitNode(AVLNode<Key,Value>* node, int height, const Key& key,
+	AVLNode<Key,Value>*& left, int& leftHeight, AVLNode<Key,Value>*& match,
+	AVLNode<Key,Value>*& right, int& rightHeight)
+{
+	if (node == nullptr){
+		left = match = right = nullptr;
+		leftHeight = rightHeight = 0;
+		return;
+	}
+
+	AVLNode<Key, Value>* lowerChild = node->getLeft();
+	AVLNode<Key, Value>* upperChild = node->getRight();
+	int lowerHeight = height - ((node->getBalance() <= 0) ? 1 : 2);
+	int upperHeight = height - ((node->getBalance() >= 0) ? 1 : 2);
+	if (lowerChild != nullptr){
+		lowerChild->setParent(nullptr);
+	}
+	if (upperChild != nullptr){
+		upperChild->setParent(nullptr);
+	}
+
+	AVLNode<Key, Value>* middle;
+	int middleHeight;
+	if (this->comp_(node->getKey(), key)){
+		splitNode(upperChild, upperHeight, key, middle, middleHeight, match, right, rightHeight);
+		left = joinNodes(lowerChild, lowerHeight, node, middle, middleHeight, leftHeight);
+	}
+	else if (this->comp_(key, node->getKey())){
+		splitNode(lowerChild, lowerHeight, key, left, leftHeight, match, middle, middleHeight);
+		right = joinNodes(middle, middleHeight, node, upperChild, upperHeight, rightHeight);
+	}
+	else{
+		node->setLeft(nullptr);
+		node->setRight(nullptr);
+		match = node;
+		left = lowerChild;
+		leftHeight = lowerHeight;
+		right = upperChild;
+		rightHeight = upperHeight;
+	}
+}
+
+/**
+* joinNodes() without a middle node: the largest node of left is taken out
+* and used as the pivot.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::joinNodes(AVLNode<Key,Value>* left, int leftHeight,
+	AVLNode<Key,Value>* right, int rightHeight, int& height)
+{
+	if (left == nullptr){
+		height = rightHeight;
+		return right;
+	}
+	AVLNode<Key, Value>* last;
+	int restHeight;
+	AVLNode<Key, Value>* rest = splitLast(left, leftHeight, restHeight, last);
+	return joinNodes(rest, restHeight, last, right, rightHeight, height);
+}
+
+/**
+* Detaches the largest node of the subtree at node into last and returns
+* the remaining subtree (with its height in restHeight). O(height).
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::splitLast(AVLNode<Key,Value>* node, int height,
+	int& restHeight, AVLNode<Key,Value>*& last)
+{
+	AVLNode<Key, Value>* lowerChild = node->getLeft();
+	AVLNode<Key, Value>* upperChild = node->getRight();
+	int lowerHeight = height - ((node->getBalance() <= 0) ? 1 : 2);
+	int upperHeight = height - ((node->getBalance() >= 0) ? 1 : 2);
+	if (lowerChild != nullptr){
+		lowerChild->setParent(nullptr);
+	}
+	if (upperChild == nullptr){
+		node->setLeft(nullptr);
+		last = node;
+		restHeight = lowerHeight;
+		return lowerChild;
+	}
+	upperChild->setParent(nullptr);
+	int upperRestHeight;
+	AVLNode<Key, Value>* upperRest = splitLast(upperChild, upperHeight, upperRestHeight, last);
+	return joinNodes(lowerChild, lowerHeight, node, upperRest, upperRestHeight, restHeight);
+}
+
+/**
+* Adds every item of other whose key is not already here. O(m log(n/m + 1))
+* work for trees of sizes m <= n; other is left empty.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::unionWith(AVLTree& other)
+{
+	applySetOperation(SET_UNION, other);
+}
+
+/**
+* Keeps only the items whose key also appears in other; other is left empty.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::intersectWith(AVLTree& other)
+{
+	applySetOperation(SET_INTERSECTION, other);
+}
+
+/**
+* Removes every item whose key appears in other; other is left empty.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::differenceWith(AVLTree& other)
+{
+	applySetOperation(SET_DIFFERENCE, other);
+}
+
+/**
+* Runs a set operation over both whole trees, then frees the nodes it
+* dropped. Only the recursion runs in parallel; the pool is touched here,
+* on the calling thread.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::applySetOperation(SetOperation op, AVLTree& other)
+{
+	if (&other == this){
+		if (op == SET_DIFFERENCE){
+			this->clear();
 		}
-		else if (grandp -> getBalance() == -2){
-			insertFix(curr,parent,grandp);
-			return;
+		return;
+	}
+	this->adoptPoolsOf(other);
+
+	AVLNode<Key, Value>* a = static_cast<AVLNode<Key, Value>*>(this->root_);
+	AVLNode<Key, Value>* b = static_cast<AVLNode<Key, Value>*>(other.root_);
+	int aHeight = height();
+	int bHeight = other.height();
+	// detached from both trees, so rotations below never write a root_
+	this->root_ = nullptr;
+	other.root_ = nullptr;
+
+	std::vector<AVLNode<Key, Value>*> discarded;
+	int resultHeight;
+	this->root_ = setOperationNodes(op, a, aHeight, b, bHeight, setOperationForkDepth(), discarded, resultHeight);
+	for (size_t i = 0; i < discarded.size(); ++i){
+		destroyNode(discarded[i]);
+	}
+}
+
+/**
+* Divide and conquer over detached subtrees a and b: a's root splits b,
+* both halves recurse, and the results are joined back around a's root if
+* the operation keeps it. While forkDepth allows and the subtrees are big
+* enough, the left half runs on its own thread. Nodes that drop out are
+* appended to discarded rather than freed, since the pool is not shared
+* between threads.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::setOperationNodes(SetOperation op,
+	AVLNode<Key,Value>* a, int aHeight, AVLNode<Key,Value>* b, int bHeight, int forkDepth,
+	std::vector<AVLNode<Key,Value>*>& discarded, int& height)
+{
+	if (a == nullptr || b == nullptr){
+		if (op == SET_UNION || (op == SET_DIFFERENCE && a != nullptr)){
+			height = (a != nullptr) ? aHeight : bHeight;
+			return (a != nullptr) ? a : b;
 		}
-		else{
-			curr = parent;
-			parent = grandp;
-			grandp = grandp -> getParent();
+		collectNodes((a != nullptr) ? a : b, discarded);
+		height = 0;
+		return nullptr;
+	}
+
+	AVLNode<Key, Value>* aLeft = a->getLeft();
+	AVLNode<Key, Value>* aRight = a->getRight();
+	int aLeftHeight = aHeight - ((a->getBalance() <= 0) ? 1 : 2);
+	int aRightHeight = aHeight - ((a->getBalance() >= 0) ? 1 : 2);
+	if (aLeft != nullptr){
+		aLeft->setParent(nullptr);
+	}
+	if (aRight != nullptr){
+		aRight->setParent(nullptr);
+	}
+
+	AVLNode<Key, Value>* bLeft;
+	AVLNode<Key, Value>* match;
+	AVLNode<Key, Value>* bRight;
+	int bLeftHeight, bRightHeight;
+	splitNode(b, bHeight, a->getKey(), bLeft, bLeftHeight, match, bRight, bRightHeight);
+
+	AVLNode<Key, Value>* left;
+	AVLNode<Key, Value>* right;
+	int leftHeight, rightHeight;
+	if (forkDepth > 0 && subtreeSize(a) + subtreeSize(b) >= AVL_SET_OPERATION_GRAIN){
+		std::vector<AVLNode<Key, Value>*> rightDiscarded;
+		std::future<AVLNode<Key, Value>*> leftResult = std::async(std::launch::async,
+			&AVLTree::setOperationNodes, this, op, aLeft, aLeftHeight, bLeft, bLeftHeight,
+			forkDepth - 1, std::ref(discarded), std::ref(leftHeight));
+		right = setOperationNodes(op, aRight, aRightHeight, bRight, bRightHeight,
+			forkDepth - 1, rightDiscarded, rightHeight);
+		left = leftResult.get();
+		discarded.insert(discarded.end(), rightDiscarded.begin(), rightDiscarded.end());
+	}
+	else{
+		left = setOperationNodes(op, aLeft, aLeftHeight, bLeft, bLeftHeight, 0, discarded, leftHeight);
+		right = setOperationNodes(op, aRight, aRightHeight, bRight, bRightHeight, 0, discarded, rightHeight);
+	}
+
+	// a union keeps a's item over b's, so a shared key drops b's node
+	if (match != nullptr){
+		discarded.push_back(match);
+	}
+	bool keepRoot = (op == SET_UNION) || ((op == SET_INTERSECTION) == (match != nullptr));
+	if (keepRoot){
+		return joinNodes(left, leftHeight, a, right, rightHeight, height);
+	}
+	discarded.push_back(a);
+	return joinNodes(left, leftHeight, right, rightHeight, height);
+}
+
+/**
+* Appends every node of the subtree at node to nodes.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::collectNodes(AVLNode<Key,Value>* node, std::vector<AVLNode<Key,Value>*>& nodes)
+{
+	size_t next = nodes.size();
+	if (node != nullptr){
+		nodes.push_back(node);
+	}
+	// the vector doubles as the work list
+	for (; next < nodes.size(); ++next){
+		if (nodes[next]->getLeft() != nullptr){
+			nodes.push_back(nodes[next]->getLeft());
+		}
+		if (nodes[next]->getRight() != nullptr){
+			nodes.push_back(nodes[next]->getRight());
 		}
 	}
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* curr, AVLNode<Key,Value>* parent, AVLNode<Key,Value>* grandp){
+/**
+* How many levels of the set-operation recursion may fork a thread: enough
+* for about two tasks per hardware thread, and none on a single core.
+*/
+template<class Key, class Value, class Compare>
+int AVLTree<Key, Value, Compare>::setOperationForkDepth()
+{
+	unsigned threads = std::thread::hardware_concurrency();
+	if (threads <= 1){
+		return 0;
+	}
+	int depth = 1;
+	while ((1u << (depth - 1)) < threads){
+		++depth;
+	}
+	return depth;
+}
+
+/**
+* Returns the number of levels in the tree. The balance factors say which
+* child is taller, so only one root-to-leaf path is walked: O(log n).
+*/
+template<class Key, class Value, class Compare>
+int AVLTree<Key, Value, Compare>::height() const
+{
+	int levels = 0;
+	AVLNode<Key, Value>* curr = static_cast<AVLNode<Key, Value>*>(this->root_);
+	while (curr != nullptr){
+		++levels;
+		curr = (curr->getBalance() < 0) ? curr->getLeft() : curr->getRight();
+	}
+	return levels;
+}
+
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::insertFix(AVLNode<Key,Value>* curr, AVLNode<Key,Value>* parent, AVLNode<Key,Value>* grandp){
     if(parent == NULL || parent->getParent() == NULL || grandp->getBalance() == 0){
         return;
     }
@@ -292,8 +1276,8 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key,Value>* curr, AVLNode<Key,Value>
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>:: remove(const Key& key)
 {
 	AVLNode<Key,Value>* curr = static_cast<AVLNode<Key,Value>*>(this->internalFind(key));
 	if (curr == nullptr){
@@ -332,7 +1316,7 @@ void AVLTree<Key, Value>:: remove(const Key& key)
 		else if (isRoot){
 			this -> root_ = nullptr;
 		}
-		delete curr;
+		this->destroyNode(curr);
 	}
 	else if (curr->getLeft()==nullptr || curr->getRight()==nullptr){
 		if (curr->getLeft()==nullptr){
@@ -356,10 +1340,10 @@ void AVLTree<Key, Value>:: remove(const Key& key)
 		}
 		
 		child -> setParent(parent);
-		delete curr;
+		this->destroyNode(curr);
 	}
 	else{
-		AVLNode<Key,Value>* pred = static_cast<AVLNode<Key,Value>*>(BinarySearchTree<Key,Value>::predecessor(curr));
+		AVLNode<Key,Value>* pred = static_cast<AVLNode<Key,Value>*>(BinarySearchTree<Key, Value, Compare>::predecessor(curr));
 		child = pred -> getLeft();
 		//pred->getParent()->setRight(child);
 		nodeSwap(curr, pred);
@@ -377,14 +1361,18 @@ void AVLTree<Key, Value>:: remove(const Key& key)
 		if (child != nullptr){
 			child -> setParent(parent);
 		}
-		delete curr;
+		this->destroyNode(curr);
+	}
+	if (parent != nullptr){
+		parent->setSize(parent->getSize() - 1);
+		addToAncestorSizes(parent, -1);
 	}
 	removeFix(parent, diff);
 
 }
 
-template<class Key, class Value>
-void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node,int diff){
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::removeFix(AVLNode<Key,Value>* node,int diff){
 	if (diff == 0){
 		return;
 	}
@@ -495,8 +1483,8 @@ void AVLTree<Key,Value>::removeFix(AVLNode<Key,Value>* node,int diff){
 	}
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rightRotate(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2) 
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::rightRotate(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2) 
 {
   AVLNode<Key, Value>* parent_n2 = n2->getParent();
   n2->setLeft(n1->getRight());
@@ -506,19 +1494,21 @@ void AVLTree<Key, Value>::rightRotate(AVLNode<Key,Value>* n1, AVLNode<Key,Value>
   n1->setRight(n2);
   n2->setParent(n1);
   n1->setParent(parent_n2);
+  updateSize(n2);
+  updateSize(n1);
   if (parent_n2 != nullptr) {
     if (parent_n2->getLeft() == n2) {
       parent_n2->setLeft(n1);
     } else {
       parent_n2->setRight(n1);
     }
-  } else {
+  } else if (this->root_ == n2) {
     this->root_ = n1;
   }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::leftRotate(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2) 
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::leftRotate(AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2) 
 {
   AVLNode<Key, Value>* parent_n2 = n2->getParent();
   n2->setRight(n1->getLeft());
@@ -528,24 +1518,157 @@ void AVLTree<Key, Value>::leftRotate(AVLNode<Key,Value>* n1, AVLNode<Key,Value>*
   n1->setLeft(n2);
   n2->setParent(n1);
   n1->setParent(parent_n2);
+  updateSize(n2);
+  updateSize(n1);
   if (parent_n2 != nullptr) {
     if (parent_n2->getLeft() == n2) {
       parent_n2->setLeft(n1);
     } else {
       parent_n2->setRight(n1);
     }
-  } else {
+  } else if (this->root_ == n2) {
     this->root_ = n1;
   }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
-	BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+	BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
 	int8_t temp = n1 -> getBalance();
 	n1 -> setBalance(n2 -> getBalance());
 	n2 -> setBalance(temp);
+
+	// sizes belong to tree positions, not to keys
+	size_t tempSize = n1 -> getSize();
+	n1 -> setSize(n2 -> getSize());
+	n2 -> setSize(tempSize);
+}
+
+template<class Key, class Value, class Compare>
+size_t AVLTree<Key, Value, Compare>::subtreeSize(AVLNode<Key,Value>* node)
+{
+	return (node == nullptr) ? 0 : node->getSize();
+}
+
+/**
+* Recomputes a node's size from its children, which must already be correct.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::updateSize(AVLNode<Key,Value>* node)
+{
+	node->setSize(1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight()));
+}
+
+/**
+* Adds delta to the size of every proper ancestor of node.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::addToAncestorSizes(AVLNode<Key,Value>* node, std::ptrdiff_t delta)
+{
+	for (AVLNode<Key,Value>* curr = node->getParent(); curr != nullptr; curr = curr->getParent()){
+		curr->setSize(curr->getSize() + delta);
+	}
+}
+
+/**
+* Returns the number of items in the tree.
+*/
+template<class Key, class Value, class Compare>
+size_t AVLTree<Key, Value, Compare>::size() const
+{
+	return subtreeSize(static_cast<AVLNode<Key,Value>*>(this->root_));
+}
+
+/**
+* Returns how many keys in the tree are strictly less than key.
+*/
+template<class Key, class Value, class Compare>
+size_t AVLTree<Key, Value, Compare>::rank(const Key& key) const
+{
+	return countBelow(key, false);
+}
+
+/**
+* Returns the number of keys in [lo, hi] from two rank descents: O(log n)
+* however many keys fall in the range.
+*/
+template<class Key, class Value, class Compare>
+size_t AVLTree<Key, Value, Compare>::countRange(const Key& lo, const Key& hi) const
+{
+	if (this->comp_(hi, lo)){
+		return 0;
+	}
+	return countBelow(hi, true) - countBelow(lo, false);
+}
+
+/**
+* Counts the keys less than key, or not greater than key if inclusive is set.
+*/
+template<class Key, class Value, class Compare>
+size_t AVLTree<Key, Value, Compare>::countBelow(const Key& key, bool inclusive) const
+{
+	size_t below = 0;
+	AVLNode<Key,Value>* curr = static_cast<AVLNode<Key,Value>*>(this->root_);
+	while (curr != nullptr){
+		bool goRight = inclusive ? !this->comp_(key, curr->getKey()) : this->comp_(curr->getKey(), key);
+		if (goRight){
+			below += subtreeSize(curr->getLeft()) + 1;
+			curr = curr->getRight();
+		}
+		else{
+			curr = curr->getLeft();
+		}
+	}
+	return below;
+}
+
+/**
+* Returns an iterator to the k-th smallest item (counting from 0),
+* or end() if the tree holds k or fewer items.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+AVLTree<Key, Value, Compare>::select(size_t k) const
+{
+	AVLNode<Key,Value>* curr = static_cast<AVLNode<Key,Value>*>(this->root_);
+	while (curr != nullptr){
+		size_t leftSize = subtreeSize(curr->getLeft());
+		if (k < leftSize){
+			curr = curr->getLeft();
+		}
+		else if (k == leftSize){
+			break;
+		}
+		else{
+			k -= leftSize + 1;
+			curr = curr->getRight();
+		}
+	}
+	return this->makeIterator(curr);
+}
+
+/**
+* Returns an iterator k positions past it (or end() if that runs off the tree).
+* The position of it is recovered by walking up to the root, so this costs
+* O(log n) no matter how large k is.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+AVLTree<Key, Value, Compare>::advance(typename BinarySearchTree<Key, Value, Compare>::iterator it, size_t k) const
+{
+	AVLNode<Key,Value>* curr = static_cast<AVLNode<Key,Value>*>(BinarySearchTree<Key, Value, Compare>::iteratorNode(it));
+	if (curr == nullptr){
+		return it;
+	}
+	size_t position = subtreeSize(curr->getLeft());
+	for (AVLNode<Key,Value>* parent = curr->getParent(); parent != nullptr; parent = parent->getParent()){
+		if (parent->getRight() == curr){
+			position += subtreeSize(parent->getLeft()) + 1;
+		}
+		curr = parent;
+	}
+	return select(position + k);
 }
 
 
@@ -0,0 +1,896 @@
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+
+#include <stdexcept>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <new>
+#include <type_traits>
+#include <cstddef>
+#include "node_pool.h"
+#include "simd_search.h"
+
+/**
+* A B+tree with the insert/remove/find/iterator/operator[] interface of
+* BinarySearchTree, for keys that are cheap to copy.
+*
+* Nodes are NodeBytes long (a few cache lines by default) and keep their
+* keys in one sorted array, so a lookup touches about log_B(n) nodes
+* instead of log_2(n). Items live only in the leaves, which are linked
+* both ways for iteration and range scans. Key and Value must be default
+* constructible and assignable, since entries shift within node arrays.
+*
+* Unlike BinarySearchTree, any insert or remove invalidates iterators, and
+* dereferencing one yields a pair of references rather than a reference
+* to a stored pair.
+*/
+template <class Key, class Value, class Compare = std::less<Key>, size_t NodeBytes = 256>
+class BPlusTree
+{
+protected:
+    // Entries per node; each kind of node fills about NodeBytes
+    static const size_t LEAF_CAPACITY =
+        (NodeBytes - 3 * sizeof(void*)) / (sizeof(Key) + sizeof(Value)) > 4 ?
+        (NodeBytes - 3 * sizeof(void*)) / (sizeof(Key) + sizeof(Value)) : 4;
+    static const size_t INNER_CAPACITY =
+        (NodeBytes - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(void*)) > 4 ?
+        (NodeBytes - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(void*)) : 4;
+
+    struct NodeHeader
+    {
+        size_t count_;
+    };
+
+    struct Leaf : NodeHeader
+    {
+        Leaf* prev_;
+        Leaf* next_;
+        Key keys_[LEAF_CAPACITY];
+        Value values_[LEAF_CAPACITY];
+    };
+
+    // keys_[i] separates children_[i] (keys below it) from children_[i + 1]
+    struct Inner : NodeHeader
+    {
+        Key keys_[INNER_CAPACITY];
+        NodeHeader* children_[INNER_CAPACITY + 1];
+    };
+
+public:
+    BPlusTree();
+    explicit BPlusTree(const Compare& comp);
+    ~BPlusTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    int height() const;
+    bool empty() const;
+    size_t size() const;
+    Compare keyCompare() const;
+
+    /**
+    * A bidirectional iterator over the linked leaves. *it is a pair of
+    * references to the key (read-only) and the value.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key&, Value&> reference;
+
+        /**
+        * Lets it->first and it->second work on the reference pair.
+        */
+        class pointer
+        {
+        public:
+            explicit pointer(const reference& item) : item_(item) {}
+            reference* operator->() { return &item_; }
+        private:
+            reference item_;
+        };
+
+        iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BPlusTree<Key, Value, Compare, NodeBytes>;
+        iterator(Leaf* leaf, size_t index, const BPlusTree<Key, Value, Compare, NodeBytes>* tree);
+        Leaf* leaf_;
+        size_t index_;
+        // needed to step back from end(), where leaf_ is NULL
+        const BPlusTree<Key, Value, Compare, NodeBytes>* tree_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lowerBound(const Key& key) const;
+    iterator upperBound(const Key& key) const;
+
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    Leaf* findLeaf(const Key& key) const;
+    size_t lowerIndex(const Key* keys, size_t count, const Key& key) const;
+    size_t upperIndex(const Key* keys, size_t count, const Key& key) const;
+    size_t lowerIndex(const Key* keys, size_t count, const Key& key, std::true_type scalarKeys) const;
+    size_t lowerIndex(const Key* keys, size_t count, const Key& key, std::false_type scalarKeys) const;
+    size_t upperIndex(const Key* keys, size_t count, const Key& key, std::true_type scalarKeys) const;
+    size_t upperIndex(const Key* keys, size_t count, const Key& key, std::false_type scalarKeys) const;
+
+    bool insertAt(NodeHeader* node, int level, const std::pair<const Key, Value>& item,
+                  Key& splitKey, NodeHeader*& sibling);
+    bool removeAt(NodeHeader* node, int level, const Key& key);
+    void fixUnderflow(Inner* parent, size_t index, int childLevel);
+    void mergeChildren(Inner* parent, size_t index, int childLevel);
+    static size_t minimumCount(int level);
+
+    Leaf* newLeaf();
+    Inner* newInner();
+    void freeNode(NodeHeader* node, int level);
+    void freeSubtree(NodeHeader* node, int level);
+    bool checkNode(const NodeHeader* node, int level, const Key* lo, const Key* hi, size_t& items) const;
+
+private:
+    // Not copyable
+    BPlusTree(const BPlusTree& other);
+    BPlusTree& operator=(const BPlusTree& other);
+
+protected:
+    NodeHeader* root_;
+    Leaf* first_;
+    Leaf* last_;
+    int height_;        // levels, counting the leaves; 0 when empty
+    size_t size_;
+    NodePool leafPool_;
+    NodePool innerPool_;
+    Compare comp_;
+};
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the BPlusTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::iterator() :
+    leaf_(NULL),
+    index_(0),
+    tree_(NULL)
+{
+
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::iterator(
+    Leaf* leaf, size_t index, const BPlusTree<Key, Value, Compare, NodeBytes>* tree) :
+    leaf_(leaf),
+    index_(index),
+    tree_(tree)
+{
+
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator::reference
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator*() const
+{
+    return reference(leaf_->keys_[index_], leaf_->values_[index_]);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator::pointer
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator->() const
+{
+    return pointer(**this);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator&
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator++()
+{
+    if (++index_ == leaf_->count_){
+        leaf_ = leaf_->next_;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Stepping back from end() lands on the last item.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator&
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator--()
+{
+    if (leaf_ == NULL){
+        leaf_ = tree_->last_;
+        index_ = leaf_->count_ - 1;
+    }
+    else if (index_ == 0){
+        leaf_ = leaf_->prev_;
+        index_ = leaf_->count_ - 1;
+    }
+    else{
+        --index_;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, NodeBytes>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+  -------------------------------------------------------------
+  End implementations for the BPlusTree::iterator class.
+  -------------------------------------------------------------
+*/
+
+/*
+  --------------------------------------------------
+  Begin implementations for the BPlusTree class.
+  --------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+BPlusTree<Key, Value, Compare, NodeBytes>::BPlusTree() :
+    root_(NULL),
+    first_(NULL),
+    last_(NULL),
+    height_(0),
+    size_(0),
+    leafPool_(sizeof(Leaf), alignof(Leaf)),
+    innerPool_(sizeof(Inner), alignof(Inner)),
+    comp_()
+{
+
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+BPlusTree<Key, Value, Compare, NodeBytes>::BPlusTree(const Compare& comp) :
+    root_(NULL),
+    first_(NULL),
+    last_(NULL),
+    height_(0),
+    size_(0),
+    leafPool_(sizeof(Leaf), alignof(Leaf)),
+    innerPool_(sizeof(Inner), alignof(Inner)),
+    comp_(comp)
+{
+
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+BPlusTree<Key, Value, Compare, NodeBytes>::~BPlusTree()
+{
+    clear();
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is already
+* present. A full node splits in half and passes its new sibling up; a
+* full root grows the tree by one level.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, NodeBytes>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	if (root_ == NULL){
+		Leaf* leaf = newLeaf();
+		leaf->keys_[0] = keyValuePair.first;
+		leaf->values_[0] = keyValuePair.second;
+		leaf->count_ = 1;
+		root_ = first_ = last_ = leaf;
+		height_ = 1;
+		size_ = 1;
+		return;
+	}
+
+	Key splitKey;
+	NodeHeader* sibling = NULL;
+	if (insertAt(root_, height_, keyValuePair, splitKey, sibling)){
+		Inner* root = newInner();
+		root->keys_[0] = splitKey;
+		root->children_[0] = root_;
+		root->children_[1] = sibling;
+		root->count_ = 1;
+		root_ = root;
+		++height_;
+	}
+}
+
+/**
+* Removes the key if present. A node left less than half full borrows an
+* entry from a sibling or merges with it; a root left with one child is
+* replaced by that child.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, NodeBytes>::remove(const Key& key)
+{
+	if (root_ == NULL || !removeAt(root_, height_, key)){
+		return;
+	}
+	--size_;
+	if (height_ > 1 && root_->count_ == 0){
+		NodeHeader* child = static_cast<Inner*>(root_)->children_[0];
+		freeNode(root_, height_);
+		root_ = child;
+		--height_;
+	}
+	else if (height_ == 1 && root_->count_ == 0){
+		freeNode(root_, 1);
+		root_ = NULL;
+		first_ = last_ = NULL;
+		height_ = 0;
+	}
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, NodeBytes>::clear()
+{
+	if (root_ != NULL){
+		freeSubtree(root_, height_);
+	}
+	root_ = NULL;
+	first_ = last_ = NULL;
+	height_ = 0;
+	size_ = 0;
+	leafPool_.release();
+	innerPool_.release();
+}
+
+/**
+* Checks the B+tree invariants: every leaf at the same depth, keys sorted
+* and within their separators, every node but the root at least half full,
+* and the leaf chain holding exactly size() items.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, NodeBytes>::isBalanced() const
+{
+	if (root_ == NULL){
+		return size_ == 0;
+	}
+	size_t items = 0;
+	if (!checkNode(root_, height_, NULL, NULL, items) || items != size_){
+		return false;
+	}
+	size_t chained = 0;
+	for (Leaf* leaf = first_; leaf != NULL; leaf = leaf->next_){
+		chained += leaf->count_;
+		if (leaf->next_ == NULL && leaf != last_){
+			return false;
+		}
+	}
+	return chained == size_;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+int BPlusTree<Key, Value, Compare, NodeBytes>::height() const
+{
+	return height_;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, NodeBytes>::empty() const
+{
+	return root_ == NULL;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::size() const
+{
+	return size_;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+Compare BPlusTree<Key, Value, Compare, NodeBytes>::keyCompare() const
+{
+	return comp_;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, NodeBytes>::begin() const
+{
+	return iterator(first_, 0, this);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, NodeBytes>::end() const
+{
+	return iterator(NULL, 0, this);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, NodeBytes>::find(const Key& key) const
+{
+	Leaf* leaf = findLeaf(key);
+	if (leaf == NULL){
+		return end();
+	}
+	size_t index = lowerIndex(leaf->keys_, leaf->count_, key);
+	if (index == leaf->count_ || comp_(key, leaf->keys_[index])){
+		return end();
+	}
+	return iterator(leaf, index, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, NodeBytes>::lowerBound(const Key& key) const
+{
+	Leaf* leaf = findLeaf(key);
+	if (leaf == NULL){
+		return end();
+	}
+	size_t index = lowerIndex(leaf->keys_, leaf->count_, key);
+	if (index == leaf->count_){
+		return iterator(leaf->next_, 0, this);
+	}
+	return iterator(leaf, index, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::iterator
+BPlusTree<Key, Value, Compare, NodeBytes>::upperBound(const Key& key) const
+{
+	Leaf* leaf = findLeaf(key);
+	if (leaf == NULL){
+		return end();
+	}
+	size_t index = upperIndex(leaf->keys_, leaf->count_, key);
+	if (index == leaf->count_){
+		return iterator(leaf->next_, 0, this);
+	}
+	return iterator(leaf, index, this);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+Value& BPlusTree<Key, Value, Compare, NodeBytes>::operator[](const Key& key)
+{
+	iterator it = find(key);
+	if (it == end()) throw std::out_of_range("Invalid key");
+	return it.leaf_->values_[it.index_];
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+Value const & BPlusTree<Key, Value, Compare, NodeBytes>::operator[](const Key& key) const
+{
+	iterator it = find(key);
+	if (it == end()) throw std::out_of_range("Invalid key");
+	return it.leaf_->values_[it.index_];
+}
+
+/**
+* Descends to the leaf whose range covers key, or NULL if the tree is empty.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::Leaf*
+BPlusTree<Key, Value, Compare, NodeBytes>::findLeaf(const Key& key) const
+{
+	NodeHeader* node = root_;
+	for (int level = height_; level > 1; --level){
+		Inner* inner = static_cast<Inner*>(node);
+		node = inner->children_[upperIndex(inner->keys_, inner->count_, key)];
+	}
+	return static_cast<Leaf*>(node);
+}
+
+/**
+* Number of keys in the sorted array that are less than key (lowerIndex)
+* or not greater than key (upperIndex). For scalar keys this counts over
+* the whole node without branching (with vector compares for integers,
+* see simd_search.h), which beats a binary search at these node sizes;
+* other keys use std::lower_bound/upper_bound.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::lowerIndex(const Key* keys, size_t count, const Key& key) const
+{
+	return lowerIndex(keys, count, key, std::integral_constant<bool, std::is_scalar<Key>::value>());
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::upperIndex(const Key* keys, size_t count, const Key& key) const
+{
+	return upperIndex(keys, count, key, std::integral_constant<bool, std::is_scalar<Key>::value>());
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::lowerIndex(const Key* keys, size_t count, const Key& key, std::true_type) const
+{
+	return countLess(keys, count, key, comp_);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::lowerIndex(const Key* keys, size_t count, const Key& key, std::false_type) const
+{
+	return std::lower_bound(keys, keys + count, key, comp_) - keys;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::upperIndex(const Key* keys, size_t count, const Key& key, std::true_type) const
+{
+	return countNotGreater(keys, count, key, comp_);
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::upperIndex(const Key* keys, size_t count, const Key& key, std::false_type) const
+{
+	return std::upper_bound(keys, keys + count, key, comp_) - keys;
+}
+
+/**
+* Inserts item into the subtree at node, level levels above the leaves
+* (1 for a leaf). Returns true if node split, with the new right sibling
+* and the smallest key routed to it in sibling and splitKey.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, NodeBytes>::insertAt(
+    NodeHeader* node, int level, const std::pair<const Key, Value>& item,
+    Key& splitKey, NodeHeader*& sibling)
+{
+	if (level == 1){
+		Leaf* leaf = static_cast<Leaf*>(node);
+		size_t index = lowerIndex(leaf->keys_, leaf->count_, item.first);
+		if (index < leaf->count_ && !comp_(item.first, leaf->keys_[index])){
+			leaf->values_[index] = item.second;
+			return false;
+		}
+		++size_;
+
+		Leaf* target = leaf;
+		bool split = false;
+		if (leaf->count_ == LEAF_CAPACITY){
+			Leaf* right = newLeaf();
+			size_t half = LEAF_CAPACITY / 2;
+			std::copy(leaf->keys_ + half, leaf->keys_ + LEAF_CAPACITY, right->keys_);
+			std::copy(leaf->values_ + half, leaf->values_ + LEAF_CAPACITY, right->values_);
+			right->count_ = LEAF_CAPACITY - half;
+			leaf->count_ = half;
+			right->prev_ = leaf;
+			right->next_ = leaf->next_;
+			if (leaf->next_ != NULL){
+				leaf->next_->prev_ = right;
+			}
+			else{
+				last_ = right;
+			}
+			leaf->next_ = right;
+			if (index > half){
+				target = right;
+				index -= half;
+			}
+			sibling = right;
+			split = true;
+		}
+
+		std::copy_backward(target->keys_ + index, target->keys_ + target->count_, target->keys_ + target->count_ + 1);
+		std::copy_backward(target->values_ + index, target->values_ + target->count_, target->values_ + target->count_ + 1);
+		target->keys_[index] = item.first;
+		target->values_[index] = item.second;
+		++target->count_;
+		if (split){
+			splitKey = static_cast<Leaf*>(sibling)->keys_[0];
+		}
+		return split;
+	}
+
+	Inner* inner = static_cast<Inner*>(node);
+	size_t index = upperIndex(inner->keys_, inner->count_, item.first);
+	Key childKey;
+	NodeHeader* childSibling = NULL;
+	if (!insertAt(inner->children_[index], level - 1, item, childKey, childSibling)){
+		return false;
+	}
+
+	if (inner->count_ < INNER_CAPACITY){
+		std::copy_backward(inner->keys_ + index, inner->keys_ + inner->count_, inner->keys_ + inner->count_ + 1);
+		std::copy_backward(inner->children_ + index + 1, inner->children_ + inner->count_ + 1, inner->children_ + inner->count_ + 2);
+		inner->keys_[index] = childKey;
+		inner->children_[index + 1] = childSibling;
+		++inner->count_;
+		return false;
+	}
+
+	// Full: lay out all INNER_CAPACITY + 1 keys, then push the middle one up
+	Key keys[INNER_CAPACITY + 1];
+	NodeHeader* children[INNER_CAPACITY + 2];
+	std::copy(inner->keys_, inner->keys_ + index, keys);
+	keys[index] = childKey;
+	std::copy(inner->keys_ + index, inner->keys_ + INNER_CAPACITY, keys + index + 1);
+	std::copy(inner->children_, inner->children_ + index + 1, children);
+	children[index + 1] = childSibling;
+	std::copy(inner->children_ + index + 1, inner->children_ + INNER_CAPACITY + 1, children + index + 2);
+
+	size_t half = (INNER_CAPACITY + 1) / 2;
+	Inner* right = newInner();
+	std::copy(keys, keys + half, inner->keys_);
+	std::copy(children, children + half + 1, inner->children_);
+	inner->count_ = half;
+	std::copy(keys + half + 1, keys + INNER_CAPACITY + 1, right->keys_);
+	std::copy(children + half + 1, children + INNER_CAPACITY + 2, right->children_);
+	right->count_ = INNER_CAPACITY - half;
+	splitKey = keys[half];
+	sibling = right;
+	return true;
+}
+
+/**
+* Removes key from the subtree at node, repairing any child it leaves
+* underfull. Returns false if key was not there.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, NodeBytes>::removeAt(NodeHeader* node, int level, const Key& key)
+{
+	if (level == 1){
+		Leaf* leaf = static_cast<Leaf*>(node);
+		size_t index = lowerIndex(leaf->keys_, leaf->count_, key);
+		if (index == leaf->count_ || comp_(key, leaf->keys_[index])){
+			return false;
+		}
+		std::copy(leaf->keys_ + index + 1, leaf->keys_ + leaf->count_, leaf->keys_ + index);
+		std::copy(leaf->values_ + index + 1, leaf->values_ + leaf->count_, leaf->values_ + index);
+		--leaf->count_;
+		return true;
+	}
+
+	Inner* inner = static_cast<Inner*>(node);
+	size_t index = upperIndex(inner->keys_, inner->count_, key);
+	if (!removeAt(inner->children_[index], level - 1, key)){
+		return false;
+	}
+	if (inner->children_[index]->count_ < minimumCount(level - 1)){
+		fixUnderflow(inner, index, level - 1);
+	}
+	return true;
+}
+
+/**
+* Refills parent's child at index from a sibling with entries to spare,
+* rotating through the separator key, or else merges it with a sibling.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, NodeBytes>::fixUnderflow(Inner* parent, size_t index, int childLevel)
+{
+	size_t minimum = minimumCount(childLevel);
+	NodeHeader* child = parent->children_[index];
+	NodeHeader* left = (index > 0) ? parent->children_[index - 1] : NULL;
+	NodeHeader* right = (index < parent->count_) ? parent->children_[index + 1] : NULL;
+
+	if (left != NULL && left->count_ > minimum){
+		if (childLevel == 1){
+			Leaf* to = static_cast<Leaf*>(child);
+			Leaf* from = static_cast<Leaf*>(left);
+			std::copy_backward(to->keys_, to->keys_ + to->count_, to->keys_ + to->count_ + 1);
+			std::copy_backward(to->values_, to->values_ + to->count_, to->values_ + to->count_ + 1);
+			to->keys_[0] = from->keys_[from->count_ - 1];
+			to->values_[0] = from->values_[from->count_ - 1];
+			parent->keys_[index - 1] = to->keys_[0];
+		}
+		else{
+			Inner* to = static_cast<Inner*>(child);
+			Inner* from = static_cast<Inner*>(left);
+			std::copy_backward(to->keys_, to->keys_ + to->count_, to->keys_ + to->count_ + 1);
+			std::copy_backward(to->children_, to->children_ + to->count_ + 1, to->children_ + to->count_ + 2);
+			to->keys_[0] = parent->keys_[index - 1];
+			to->children_[0] = from->children_[from->count_];
+			parent->keys_[index - 1] = from->keys_[from->count_ - 1];
+		}
+		++child->count_;
+		--left->count_;
+	}
+	else if (right != NULL && right->count_ > minimum){
+		if (childLevel == 1){
+			Leaf* to = static_cast<Leaf*>(child);
+			Leaf* from = static_cast<Leaf*>(right);
+			to->keys_[to->count_] = from->keys_[0];
+			to->values_[to->count_] = from->values_[0];
+			std::copy(from->keys_ + 1, from->keys_ + from->count_, from->keys_);
+			std::copy(from->values_ + 1, from->values_ + from->count_, from->values_);
+			parent->keys_[index] = from->keys_[0];
+		}
+		else{
+			Inner* to = static_cast<Inner*>(child);
+			Inner* from = static_cast<Inner*>(right);
+			to->keys_[to->count_] = parent->keys_[index];
+			to->children_[to->count_ + 1] = from->children_[0];
+			parent->keys_[index] = from->keys_[0];
+			std::copy(from->keys_ + 1, from->keys_ + from->count_, from->keys_);
+			std::copy(from->children_ + 1, from->children_ + from->count_ + 1, from->children_);
+		}
+		++child->count_;
+		--right->count_;
+	}
+	else if (left != NULL){
+		mergeChildren(parent, index - 1, childLevel);
+	}
+	else{
+		mergeChildren(parent, index, childLevel);
+	}
+}
+
+/**
+* Folds parent's child at index + 1 into the child at index and drops the
+* separator between them. The caller guarantees the result fits.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, NodeBytes>::mergeChildren(Inner* parent, size_t index, int childLevel)
+{
+	NodeHeader* left = parent->children_[index];
+	NodeHeader* right = parent->children_[index + 1];
+	if (childLevel == 1){
+		Leaf* to = static_cast<Leaf*>(left);
+		Leaf* from = static_cast<Leaf*>(right);
+		std::copy(from->keys_, from->keys_ + from->count_, to->keys_ + to->count_);
+		std::copy(from->values_, from->values_ + from->count_, to->values_ + to->count_);
+		to->count_ += from->count_;
+		to->next_ = from->next_;
+		if (from->next_ != NULL){
+			from->next_->prev_ = to;
+		}
+		else{
+			last_ = to;
+		}
+	}
+	else{
+		Inner* to = static_cast<Inner*>(left);
+		Inner* from = static_cast<Inner*>(right);
+		to->keys_[to->count_] = parent->keys_[index];
+		std::copy(from->keys_, from->keys_ + from->count_, to->keys_ + to->count_ + 1);
+		std::copy(from->children_, from->children_ + from->count_ + 1, to->children_ + to->count_ + 1);
+		to->count_ += from->count_ + 1;
+	}
+	freeNode(right, childLevel);
+
+	std::copy(parent->keys_ + index + 1, parent->keys_ + parent->count_, parent->keys_ + index);
+	std::copy(parent->children_ + index + 2, parent->children_ + parent->count_ + 1, parent->children_ + index + 1);
+	--parent->count_;
+}
+
+/**
+* Fewest entries a non-root node at level may hold.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+size_t BPlusTree<Key, Value, Compare, NodeBytes>::minimumCount(int level)
+{
+	return (level == 1) ? LEAF_CAPACITY / 2 : INNER_CAPACITY / 2;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::Leaf*
+BPlusTree<Key, Value, Compare, NodeBytes>::newLeaf()
+{
+	Leaf* leaf = new (leafPool_.allocate()) Leaf();
+	leaf->count_ = 0;
+	leaf->prev_ = leaf->next_ = NULL;
+	return leaf;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+typename BPlusTree<Key, Value, Compare, NodeBytes>::Inner*
+BPlusTree<Key, Value, Compare, NodeBytes>::newInner()
+{
+	Inner* inner = new (innerPool_.allocate()) Inner();
+	inner->count_ = 0;
+	return inner;
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, NodeBytes>::freeNode(NodeHeader* node, int level)
+{
+	if (level == 1){
+		static_cast<Leaf*>(node)->~Leaf();
+		leafPool_.deallocate(node);
+	}
+	else{
+		static_cast<Inner*>(node)->~Inner();
+		innerPool_.deallocate(node);
+	}
+}
+
+template<class Key, class Value, class Compare, size_t NodeBytes>
+void BPlusTree<Key, Value, Compare, NodeBytes>::freeSubtree(NodeHeader* node, int level)
+{
+	if (level > 1){
+		Inner* inner = static_cast<Inner*>(node);
+		for (size_t i = 0; i <= inner->count_; ++i){
+			freeSubtree(inner->children_[i], level - 1);
+		}
+	}
+	freeNode(node, level);
+}
+
+/**
+* Checks the subtree at node against the invariants listed at isBalanced(),
+* given that its keys must lie in [lo, hi) (NULL for unbounded), and adds
+* its item count to items.
+*/
+template<class Key, class Value, class Compare, size_t NodeBytes>
+bool BPlusTree<Key, Value, Compare, NodeBytes>::checkNode(
+    const NodeHeader* node, int level, const Key* lo, const Key* hi, size_t& items) const
+{
+	if (node != root_ && node->count_ < minimumCount(level)){
+		return false;
+	}
+	const Key* keys = (level == 1) ? static_cast<const Leaf*>(node)->keys_ : static_cast<const Inner*>(node)->keys_;
+	for (size_t i = 0; i < node->count_; ++i){
+		if ((i > 0 && !comp_(keys[i - 1], keys[i])) ||
+			(lo != NULL && comp_(keys[i], *lo)) || (hi != NULL && !comp_(keys[i], *hi))){
+			return false;
+		}
+	}
+	if (level == 1){
+		items += node->count_;
+		return true;
+	}
+	const Inner* inner = static_cast<const Inner*>(node);
+	for (size_t i = 0; i <= inner->count_; ++i){
+		const Key* childLo = (i == 0) ? lo : &inner->keys_[i - 1];
+		const Key* childHi = (i == inner->count_) ? hi : &inner->keys_[i];
+		if (!checkNode(inner->children_[i], level - 1, childLo, childHi, items)){
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+  ------------------------------------------------
+  End implementations for the BPlusTree class.
+  ------------------------------------------------
+*/
+
+#endif
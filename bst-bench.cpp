@@ -0,0 +1,772 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <thread>
+#include <mutex>
+#include <cmath>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "bst.h"
+#include "avlbst.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "concurrent_avlbst.h"
+#include "persistent_avlbst.h"
+#include "bplustree.h"
+#include "compact_avlbst.h"
+#include "path_avlbst.h"
+#include "mapped_tree.h"
+#include "durable_avlbst.h"
+#include "bench_timer.h"
+
+using namespace std;
+
+/**
+* Prints one result line: ns/op and millions of ops per second.
+*/
+void report(const string& name, size_t n, size_t ops, double ns)
+{
+    cout << left << setw(36) << name
+         << " n=" << setw(10) << n
+         << right << fixed << setprecision(1)
+         << setw(10) << ns / ops << " ns/op"
+         << setw(10) << setprecision(2) << ops * 1e3 / ns << " Mops/s" << endl;
+}
+
+// Keeps the optimizer from discarding lookups whose result is unused.
+volatile uint64_t benchSink;
+
+#if defined(BST_SIMD_AVX2)
+static const char BENCH_SIMD_NAME[] = "avx2";
+#elif defined(BST_SIMD_SSE42)
+static const char BENCH_SIMD_NAME[] = "sse4.2";
+#else
+static const char BENCH_SIMD_NAME[] = "no simd";
+#endif
+
+/**
+* Fills the tree with n random keys, then times random successful finds.
+*/
+template<typename Tree>
+void benchLookup(const string& name, size_t n, size_t ops)
+{
+    mt19937_64 rng(42);
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = rng();
+    }
+
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], i));
+    }
+
+    vector<uint64_t> probes(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = keys[rng() % n];
+    }
+
+    uint64_t sum = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i < ops; ++i) {
+        sum += tree.find(probes[i])->second;
+    }
+    double ns = timer.elapsedNs();
+    benchSink = sum;
+    report(name, n, ops, ns);
+}
+
+/**
+* Same workload as benchLookup(), on an AVLTree frozen into a FrozenIndex.
+*/
+void benchFrozenLookup(size_t n, size_t ops)
+{
+    mt19937_64 rng(42);
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = rng();
+    }
+
+    FrozenIndex<uint64_t, uint64_t> index;
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], i));
+        }
+        BenchTimer timer;
+        index = tree.freeze();
+        report("AVLTree::freeze", n, n, timer.elapsedNs());
+    }
+
+    vector<uint64_t> probes(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = keys[rng() % n];
+    }
+
+    uint64_t sum = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i < ops; ++i) {
+        sum += index.find(probes[i])->second;
+    }
+    double ns = timer.elapsedNs();
+    benchSink = sum;
+    report("FrozenIndex::find (random)", n, ops, ns);
+}
+
+/**
+* Times the in-node search BPlusTree does per level: finding a probe's
+* position among width sorted keys, with the plain loop versus the
+* vector compares simd_search.h compiles in for this target.
+*/
+template<typename Key>
+void benchNodeSearch(const string& name, size_t width, size_t ops)
+{
+    mt19937_64 rng(25);
+    const size_t blocks = 1024;
+    vector<Key> keys(blocks * width);
+    for(size_t b = 0; b < blocks; ++b) {
+        for(size_t i = 0; i < width; ++i) {
+            keys[b * width + i] = static_cast<Key>(rng());
+        }
+        sort(keys.begin() + b * width, keys.begin() + (b + 1) * width);
+    }
+    vector<Key> probes(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = static_cast<Key>(rng());
+    }
+
+    uint64_t sum = 0;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i) {
+            sum += countLessScalar(&keys[(i % blocks) * width], width, probes[i], less<Key>());
+        }
+        report(name + " scalar", width, ops, timer.elapsedNs());
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i) {
+            sum += countLess(&keys[(i % blocks) * width], width, probes[i], less<Key>());
+        }
+        report(name + " " + BENCH_SIMD_NAME, width, ops, timer.elapsedNs());
+    }
+    benchSink = sum;
+}
+
+/**
+* Fills the tree with n random keys, then times ops range scans, each
+* reading the span items from a random lowerBound() onwards.
+*/
+template<typename Tree>
+void benchRangeScan(const string& name, size_t n, size_t ops, size_t span)
+{
+    mt19937_64 rng(21);
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(rng(), i));
+    }
+
+    vector<uint64_t> starts(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        starts[i] = rng();
+    }
+
+    uint64_t sum = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i < ops; ++i) {
+        typename Tree::iterator it = tree.lowerBound(starts[i]);
+        for(size_t j = 0; j < span && it != tree.end(); ++j, ++it) {
+            sum += it->second;
+        }
+    }
+    double ns = timer.elapsedNs();
+    benchSink = sum;
+    report(name, n, ops, ns);
+}
+
+/**
+* Times loading n sorted keys: one insert per key versus assignSorted().
+*/
+void benchSortedBuild(size_t n)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair(2 * i, i);
+    }
+
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(items[i]);
+        }
+        report("AVLTree::insert (sorted load)", n, n, timer.elapsedNs());
+    }
+    {
+        SplayTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(items[i]);
+        }
+        report("SplayTree::insert (sorted load)", n, n, timer.elapsedNs());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        tree.assignSorted(items.begin(), items.end());
+        report("AVLTree::assignSorted", n, n, timer.elapsedNs());
+    }
+}
+
+/**
+* Times a restart: re-inserting n records in arrival (random) order,
+* against saving the tree to a snapshot file and loading it back.
+*/
+void benchSaveLoad(size_t n)
+{
+    mt19937_64 rng(67);
+    vector<pair<uint64_t, uint64_t> > records(n);
+    for(size_t i = 0; i < n; ++i) {
+        records[i] = make_pair(rng(), i);
+    }
+    const string path = "bst-bench.snapshot";
+
+    AVLTree<uint64_t, uint64_t> tree;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(records[i]);
+        }
+        report("AVLTree rebuild by insert", n, n, timer.elapsedNs());
+    }
+    {
+        BenchTimer timer;
+        tree.save(path);
+        report("AVLTree::save", n, n, timer.elapsedNs());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> loaded;
+        BenchTimer timer;
+        loaded.load(path);
+        report("AVLTree::load", n, n, timer.elapsedNs());
+    }
+    remove(path.c_str());
+}
+
+/**
+* Times startup from a file: AVLTree::load() of a snapshot against
+* opening a MappedTree, then ops random finds in each. Before the mapped
+* tree is opened its file is dropped from the page cache, so the first
+* finds read from disk; the page faults they take are reported per find.
+*/
+void benchMapped(size_t n, size_t ops)
+{
+    mt19937_64 rng(71);
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(rng(), i));
+    }
+    vector<uint64_t> probes(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = tree.select(rng() % n)->first;
+    }
+    const string snapshotPath = "bst-bench.snapshot";
+    const string mappedPath = "bst-bench.mapped";
+    tree.save(snapshotPath);
+    MappedTree<uint64_t, uint64_t>::write(mappedPath, tree.begin(), tree.end());
+    tree.clear();
+
+    {
+        AVLTree<uint64_t, uint64_t> loaded;
+        BenchTimer timer;
+        loaded.load(snapshotPath);
+        report("AVLTree::load", n, 1, timer.elapsedNs());
+        uint64_t sum = 0;
+        BenchTimer findTimer;
+        for(size_t i = 0; i < ops; ++i) {
+            sum += loaded.find(probes[i])->second;
+        }
+        report("AVLTree::find (random)", n, ops, findTimer.elapsedNs());
+        benchSink = sum;
+    }
+    {
+        int fd = open(mappedPath.c_str(), O_RDONLY);
+        if(fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            close(fd);
+        }
+        struct rusage before, after;
+        getrusage(RUSAGE_SELF, &before);
+        BenchTimer timer;
+        MappedTree<uint64_t, uint64_t> mapped(mappedPath);
+        report("MappedTree open", n, 1, timer.elapsedNs());
+        size_t cold = min<size_t>(ops, 1000);
+        uint64_t sum = 0;
+        BenchTimer coldTimer;
+        for(size_t i = 0; i < cold; ++i) {
+            sum += mapped.find(probes[i])->second;
+        }
+        report("MappedTree::find (first, cold)", n, cold, coldTimer.elapsedNs());
+        getrusage(RUSAGE_SELF, &after);
+        long faults = (after.ru_majflt - before.ru_majflt) + (after.ru_minflt - before.ru_minflt);
+        cout << "  page faults per cold find: " << fixed << setprecision(1) << double(faults) / cold << endl;
+        BenchTimer findTimer;
+        for(size_t i = 0; i < ops; ++i) {
+            sum += mapped.find(probes[i])->second;
+        }
+        report("MappedTree::find (random)", n, ops, findTimer.elapsedNs());
+        benchSink = sum;
+    }
+    remove(snapshotPath.c_str());
+    remove(mappedPath.c_str());
+}
+
+/**
+* Times counting ops events over n distinct keys: find() then operator[]
+* or insert(), versus a single upsert() per event.
+*/
+void benchCounters(size_t n, size_t ops)
+{
+    mt19937_64 rng(7);
+    vector<uint64_t> events(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        events[i] = rng() % n;
+    }
+
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i) {
+            if(tree.find(events[i]) != tree.end()) {
+                tree[events[i]]++;
+            }
+            else {
+                tree.insert(make_pair(events[i], uint64_t(1)));
+            }
+        }
+        report("AVLTree::find+operator[]/insert", n, ops, timer.elapsedNs());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i) {
+            tree.upsert(events[i], [](uint64_t& count) { ++count; });
+        }
+        report("AVLTree::upsert", n, ops, timer.elapsedNs());
+    }
+}
+
+/**
+* Times splitting an n-item tree at a random key and joining it back.
+*/
+void benchSplitJoin(size_t n, size_t ops)
+{
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) {
+        items[i] = make_pair(i, i);
+    }
+    AVLTree<uint64_t, uint64_t> tree;
+    tree.assignSorted(items.begin(), items.end());
+
+    mt19937_64 rng(5);
+    AVLTree<uint64_t, uint64_t> upper;
+    BenchTimer timer;
+    for(size_t i = 0; i < ops; ++i) {
+        tree.split(rng() % n, upper);
+        tree.join(upper);
+    }
+    report("AVLTree::split+join", n, ops, timer.elapsedNs());
+}
+
+/**
+* Times merging two random n-item trees: inserting one into the other
+* item by item, versus unionWith().
+*/
+void benchUnion(size_t n)
+{
+    mt19937_64 rng(9);
+    vector<pair<uint64_t, uint64_t> > first(n), second(n);
+    for(size_t i = 0; i < n; ++i) {
+        first[i] = make_pair(rng(), i);
+        second[i] = make_pair(rng(), i);
+    }
+
+    {
+        AVLTree<uint64_t, uint64_t> tree, other;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(first[i]);
+            other.insert(second[i]);
+        }
+        BenchTimer timer;
+        for(AVLTree<uint64_t, uint64_t>::iterator it = other.begin(); it != other.end(); ++it) {
+            tree.insert(*it);
+        }
+        report("AVLTree merge by insert", n, n, timer.elapsedNs());
+    }
+    {
+        AVLTree<uint64_t, uint64_t> tree, other;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(first[i]);
+            other.insert(second[i]);
+        }
+        BenchTimer timer;
+        tree.unionWith(other);
+        report("AVLTree::unionWith", n, n, timer.elapsedNs());
+    }
+}
+
+/**
+* Prints the bytes per entry of an n-item CompactAVLTree's node vector,
+* then times random finds on it. benchWrites() prints the AVLTree figure
+* and benchLookup() its find time.
+*/
+void benchCompact(size_t n, size_t ops)
+{
+    CompactAVLTree<uint64_t, uint64_t> compact;
+    compact.reserve(n);
+    mt19937_64 rng(42);
+    for(size_t i = 0; i < n; ++i) {
+        compact.insert(make_pair(rng(), i));
+    }
+    cout << left << setw(36) << "CompactAVLTree bytes/entry"
+         << " n=" << setw(10) << n
+         << right << setw(10) << compact.memoryUsage() / max<size_t>(compact.size(), 1) << endl;
+
+    benchLookup<CompactAVLTree<uint64_t, uint64_t> >("CompactAVLTree::find (random)", n, ops);
+}
+
+/**
+* Times building a tree from n random inserts and then emptying it again
+* with removes in a different random order, after printing the bytes its
+* nodes take per entry.
+*/
+template<typename Tree, typename NodeType>
+void benchWrites(const string& name, size_t n)
+{
+    cout << left << setw(36) << name + " bytes/entry"
+         << " n=" << setw(10) << n
+         << right << setw(10) << sizeof(NodeType) << endl;
+
+    mt19937_64 rng(31);
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = rng();
+    }
+
+    Tree tree;
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], i));
+        }
+        report(name + "::insert (random)", n, n, timer.elapsedNs());
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i) {
+            tree.remove(keys[i]);
+        }
+        report(name + "::remove (random)", n, n, timer.elapsedNs());
+    }
+}
+
+/**
+* Fills the tree with n random keys, then times finds whose targets follow
+* a Zipf distribution with the given exponent: the key of popularity rank
+* r is drawn with weight 1 / r^exponent, and the ranks are scattered over
+* the keys at random. An exponent of 0 gives uniform finds.
+*/
+template<typename Tree>
+void benchZipf(const string& name, size_t n, size_t ops, double exponent)
+{
+    mt19937_64 rng(61);
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = rng();
+    }
+
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], i));
+    }
+
+    vector<double> weights(n);
+    for(size_t i = 0; i < n; ++i) {
+        weights[i] = 1.0 / pow(double(i + 1), exponent);
+    }
+    discrete_distribution<size_t> rank(weights.begin(), weights.end());
+    vector<uint64_t> probes(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = keys[rank(rng)];
+    }
+
+    uint64_t sum = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i < ops; ++i) {
+        sum += tree.find(probes[i])->second;
+    }
+    double ns = timer.elapsedNs();
+    benchSink = sum;
+    ostringstream label;
+    label << name << "::find (zipf " << exponent << ")";
+    report(label.str(), n, ops, ns);
+}
+
+/**
+* Fills the tree with about n keys drawn from [0, 2n), then runs ops
+* operations on random keys from the same range: findPercent% finds, the
+* rest split evenly between inserts and removes, so the size holds steady.
+*/
+template<typename Tree>
+void benchMix(const string& name, size_t n, size_t ops, unsigned findPercent)
+{
+    mt19937_64 rng(53);
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(rng() % (2 * n), i));
+    }
+    vector<uint64_t> draws(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        draws[i] = rng();
+    }
+
+    uint64_t sum = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i < ops; ++i) {
+        uint64_t key = (draws[i] >> 8) % (2 * n);
+        unsigned kind = draws[i] % 100;
+        if(kind < findPercent) {
+            typename Tree::iterator it = tree.find(key);
+            if(it != tree.end()) {
+                sum += it->second;
+            }
+        }
+        else if(kind % 2 == 0) {
+            tree.insert(make_pair(key, i));
+        }
+        else {
+            tree.remove(key);
+        }
+    }
+    double ns = timer.elapsedNs();
+    benchSink = sum;
+    report(name + ", " + to_string(findPercent) + "% find", n, ops, ns);
+}
+
+/**
+* Times taking a read-only view of an n-item index, copying an AVLTree
+* item by item versus PersistentAVLTree::snapshot(), and the cost that
+* path copying adds to random inserts.
+*/
+void benchSnapshot(size_t n, size_t ops)
+{
+    mt19937_64 rng(17);
+    AVLTree<uint64_t, uint64_t> tree;
+    PersistentAVLTree<uint64_t, uint64_t> persistent;
+    for(size_t i = 0; i < n; ++i) {
+        uint64_t key = rng();
+        tree.insert(make_pair(key, i));
+        persistent.insert(make_pair(key, i));
+    }
+
+    {
+        BenchTimer timer;
+        AVLTree<uint64_t, uint64_t> copy;
+        for(AVLTree<uint64_t, uint64_t>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            copy.insert(*it);
+        }
+        report("AVLTree copy for a snapshot", n, 1, timer.elapsedNs());
+    }
+    {
+        BenchTimer timer;
+        PersistentAVLTree<uint64_t, uint64_t> view = persistent.snapshot();
+        benchSink += view.size();
+        report("PersistentAVLTree::snapshot", n, 1, timer.elapsedNs());
+    }
+
+    vector<uint64_t> keys(ops);
+    for(size_t i = 0; i < ops; ++i) {
+        keys[i] = rng();
+    }
+    {
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i) {
+            tree.insert(make_pair(keys[i], i));
+        }
+        report("AVLTree::insert (random)", n, ops, timer.elapsedNs());
+    }
+    {
+        PersistentAVLTree<uint64_t, uint64_t> view = persistent.snapshot();
+        BenchTimer timer;
+        for(size_t i = 0; i < ops; ++i) {
+            persistent.insert(make_pair(keys[i], i));
+        }
+        report("PersistentAVLTree::insert (random)", n, ops, timer.elapsedNs());
+        benchSink += view.size();
+    }
+}
+
+/**
+* AVLTree behind one global mutex, with the reader/writer interface of
+* ConcurrentAVLTree, as the baseline for benchConcurrent().
+*/
+class LockedAVLTree
+{
+public:
+    void insert(const pair<const uint64_t, uint64_t>& item)
+    {
+        lock_guard<mutex> lock(mutex_);
+        tree_.insertOrAssign(item.first, item.second);
+    }
+    void remove(uint64_t key)
+    {
+        lock_guard<mutex> lock(mutex_);
+        tree_.remove(key);
+    }
+    bool find(uint64_t key, uint64_t& value)
+    {
+        lock_guard<mutex> lock(mutex_);
+        AVLTree<uint64_t, uint64_t>::iterator it = tree_.find(key);
+        if(it == tree_.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+private:
+    mutex mutex_;
+    AVLTree<uint64_t, uint64_t> tree_;
+};
+
+/**
+* Fills the tree with n keys, then has each of threads threads run ops
+* operations: 90% finds, 5% inserts and 5% removes of random keys.
+* Reports total throughput across all threads.
+*/
+template<typename Tree>
+void benchConcurrent(const string& name, size_t n, size_t ops, size_t threads)
+{
+    Tree tree;
+    mt19937_64 rng(13);
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(rng() % (2 * n), i));
+    }
+
+    vector<thread> workers;
+    vector<uint64_t> sums(threads);
+    BenchTimer timer;
+    for(size_t t = 0; t < threads; ++t) {
+        workers.push_back(thread([&tree, &sums, n, ops, t]() {
+            mt19937_64 local(100 + t);
+            uint64_t sum = 0, value;
+            for(size_t i = 0; i < ops; ++i) {
+                uint64_t r = local();
+                uint64_t key = (r >> 8) % (2 * n);
+                unsigned kind = r % 20;
+                if(kind == 0) {
+                    tree.insert(make_pair(key, i));
+                }
+                else if(kind == 1) {
+                    tree.remove(key);
+                }
+                else if(tree.find(key, value)) {
+                    sum += value;
+                }
+            }
+            sums[t] = sum;
+        }));
+    }
+    for(size_t t = 0; t < threads; ++t) {
+        workers[t].join();
+        benchSink += sums[t];
+    }
+    report(name + " x" + to_string(threads), n, ops * threads, timer.elapsedNs());
+}
+
+/**
+* Has each of threads threads make ops durable inserts of random keys
+* into one DurableAVLTree, and reports committed inserts per second.
+* More writers mean more records waiting on each fsync, so each group
+* commit covers more of them; the records per fsync actually achieved
+* are printed too.
+*/
+void benchDurable(size_t ops, size_t threads)
+{
+    const string snapshotPath = "bst-bench.durable";
+    const string logPath = "bst-bench.wal";
+    remove(snapshotPath.c_str());
+    remove(logPath.c_str());
+    {
+        DurableAVLTree<uint64_t, uint64_t> tree(snapshotPath, logPath);
+        vector<thread> workers;
+        BenchTimer timer;
+        for(size_t t = 0; t < threads; ++t) {
+            workers.push_back(thread([&tree, ops, t]() {
+                mt19937_64 local(200 + t);
+                for(size_t i = 0; i < ops; ++i) {
+                    tree.insert(make_pair(local(), i));
+                }
+            }));
+        }
+        for(size_t t = 0; t < threads; ++t) {
+            workers[t].join();
+        }
+        report("DurableAVLTree::insert x" + to_string(threads), ops * threads, ops * threads, timer.elapsedNs());
+        cout << "  records per fsync: " << fixed << setprecision(1)
+             << double(tree.loggedRecords()) / max<uint64_t>(1, tree.loggedSyncs()) << endl;
+    }
+    remove(snapshotPath.c_str());
+    remove(logPath.c_str());
+}
+
+int main(int argc, char *argv[])
+{
+    size_t n = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t ops = (argc > 2) ? strtoul(argv[2], NULL, 10) : 2000000;
+
+    benchLookup<BinarySearchTree<uint64_t, uint64_t> >("BinarySearchTree::find (random)", n, ops);
+    benchLookup<AVLTree<uint64_t, uint64_t> >("AVLTree::find (random)", n, ops);
+    benchLookup<BPlusTree<uint64_t, uint64_t> >("BPlusTree::find (random)", n, ops);
+    benchFrozenLookup(n, ops);
+    benchNodeSearch<uint64_t>("uint64_t node search", 15, ops);
+    benchNodeSearch<uint32_t>("uint32_t node search", 31, ops);
+    benchRangeScan<AVLTree<uint64_t, uint64_t> >("AVLTree scan of 100", n, ops / 10, 100);
+    benchRangeScan<BPlusTree<uint64_t, uint64_t> >("BPlusTree scan of 100", n, ops / 10, 100);
+    benchSortedBuild(n);
+    benchSaveLoad(n);
+    benchMapped(n, ops);
+    benchCounters(n, ops);
+    benchSplitJoin(n, ops / 10);
+    benchUnion(n);
+    benchCompact(n, ops);
+    benchWrites<AVLTree<uint64_t, uint64_t>, AVLNode<uint64_t, uint64_t> >("AVLTree", n);
+    benchWrites<PathAVLTree<uint64_t, uint64_t>, PathAVLNode<uint64_t, uint64_t> >("PathAVLTree", n);
+    const unsigned findPercents[] = { 90, 50, 10 };
+    for(size_t i = 0; i < 3; ++i) {
+        benchMix<AVLTree<uint64_t, uint64_t> >("AVLTree", n, ops, findPercents[i]);
+        benchMix<RBTree<uint64_t, uint64_t> >("RBTree", n, ops, findPercents[i]);
+    }
+    const double exponents[] = { 0, 0.99, 1.2, 1.5 };
+    for(size_t i = 0; i < 4; ++i) {
+        benchZipf<AVLTree<uint64_t, uint64_t> >("AVLTree", n, ops, exponents[i]);
+        benchZipf<SplayTree<uint64_t, uint64_t> >("SplayTree", n, ops, exponents[i]);
+    }
+    benchSnapshot(n, ops / 4);
+    for(size_t threads = 1; threads <= 8; threads *= 2) {
+        benchConcurrent<LockedAVLTree>("AVLTree + mutex, 90% find", n, ops / 4, threads);
+        benchConcurrent<ConcurrentAVLTree<uint64_t, uint64_t> >("ConcurrentAVLTree, 90% find", n, ops / 4, threads);
+    }
+    for(size_t threads = 1; threads <= 16; threads *= 2) {
+        benchDurable(max<size_t>(1, ops / 1000 / threads), threads);
+    }
+
+    return 0;
+}
@@ -0,0 +1,359 @@
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <map>
+#include <string>
+#include <sstream>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "bst.h"
+#include "avlbst.h"
+#include "bench_timer.h"
+
+using namespace std;
+
+/**
+* Compares BinarySearchTree, AVLTree and std::map on the same keys:
+* inserts in sequential, reverse and random order, random and Zipf finds,
+* a mixed find/insert/remove stream and random removes, at each size
+* given. Run as
+*
+*   ./bst-compare [--csv] [--sizes 1000,10000,...] [--ops n]
+*
+* --csv prints one comma-separated line per result, after a header line,
+* for tracking regressions; otherwise results are printed as a table.
+* Sizes default to 1K through 1M. 100M keys works but needs about 8 GB.
+*/
+
+// Keeps the optimizer from discarding lookups whose result is unused.
+volatile uint64_t benchSink;
+
+// An unbalanced tree fed sorted keys degrades to a list, so each insert
+// walks all of it; past this size those runs are skipped.
+static const size_t DEGENERATE_MAX = 20000;
+
+// Exponent of the Zipf find workload
+static const double ZIPF_EXPONENT = 0.99;
+
+static bool csvOutput = false;
+
+/**
+* Prints one result as a table row, or as a CSV line with --csv.
+*/
+void report(const string& structure, const string& workload, size_t n, size_t ops, double ns)
+{
+    if(csvOutput) {
+        cout << structure << ',' << workload << ',' << n << ',' << ops << ','
+             << fixed << setprecision(2) << ns / ops << ',' << ops * 1e9 / ns << endl;
+        return;
+    }
+    cout << left << setw(18) << structure << setw(20) << workload
+         << " n=" << setw(10) << n
+         << right << fixed << setprecision(1)
+         << setw(10) << ns / ops << " ns/op"
+         << setw(10) << setprecision(2) << ops * 1e3 / ns << " Mops/s" << endl;
+}
+
+/**
+* Notes a run left out, in the table only: CSV consumers see no row.
+*/
+void reportSkipped(const string& structure, const string& workload, size_t n, const string& why)
+{
+    if(!csvOutput) {
+        cout << left << setw(18) << structure << setw(20) << workload
+             << " n=" << setw(10) << n << "  skipped: " << why << endl;
+    }
+}
+
+/**
+* Draws ranks 1..n with probability proportional to 1 / rank^exponent, by
+* rejection-inversion (Hörmann and Derflinger), in constant time and
+* space, unlike a table of n weights.
+*/
+class ZipfSampler
+{
+public:
+    ZipfSampler(size_t n, double exponent) :
+        n_(n),
+        exponent_(exponent),
+        hIntegralX1_(hIntegral(1.5) - 1.0),
+        hIntegralN_(hIntegral(n + 0.5)),
+        s_(2.0 - hIntegralInverse(hIntegral(2.5) - h(2.0)))
+    {
+    }
+
+    template<typename Rng>
+    size_t operator()(Rng& rng) const
+    {
+        uniform_real_distribution<double> uniform(0.0, 1.0);
+        while(true) {
+            double u = hIntegralN_ + uniform(rng) * (hIntegralX1_ - hIntegralN_);
+            double x = hIntegralInverse(u);
+            double k = min(max(floor(x + 0.5), 1.0), double(n_));
+            if(k - x <= s_ || u >= hIntegral(k + 0.5) - h(k)) {
+                return size_t(k);
+            }
+        }
+    }
+
+private:
+    double h(double x) const
+    {
+        return exp(-exponent_ * log(x));
+    }
+    double hIntegral(double x) const
+    {
+        double logX = log(x);
+        return expm1OverX((1.0 - exponent_) * logX) * logX;
+    }
+    double hIntegralInverse(double x) const
+    {
+        double t = max(x * (1.0 - exponent_), -1.0);
+        return exp(log1pOverX(t) * x);
+    }
+    // log1p(x) / x and expm1(x) / x, by series near 0
+    static double log1pOverX(double x)
+    {
+        return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+    }
+    static double expm1OverX(double x)
+    {
+        return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+    }
+
+    size_t n_;
+    double exponent_;
+    double hIntegralX1_;
+    double hIntegralN_;
+    double s_;
+};
+
+/**
+* The trees' and std::map's write calls differ; these give them one shape.
+* Like the trees' insert(), putItem() overwrites an existing key's value.
+*/
+template<typename Tree>
+void putItem(Tree& tree, uint64_t key, uint64_t value)
+{
+    tree.insert(make_pair(key, value));
+}
+
+void putItem(map<uint64_t, uint64_t>& tree, uint64_t key, uint64_t value)
+{
+    tree[key] = value;
+}
+
+template<typename Tree>
+void removeKey(Tree& tree, uint64_t key)
+{
+    tree.remove(key);
+}
+
+void removeKey(map<uint64_t, uint64_t>& tree, uint64_t key)
+{
+    tree.erase(key);
+}
+
+/**
+* Inputs shared by every structure at one size, so all of them see the
+* same keys in the same order.
+*/
+struct Workload
+{
+    Workload(size_t n, size_t ops);
+
+    size_t n;
+    vector<uint64_t> keys;          // distinct random keys, in insertion order
+    vector<uint64_t> probes;        // uniform picks from keys
+    vector<uint64_t> zipfProbes;    // Zipf-distributed picks from keys
+    vector<uint64_t> mixDraws;      // one random draw per mixed operation
+    vector<uint64_t> removeOrder;   // keys, reshuffled
+};
+
+Workload::Workload(size_t size, size_t ops) :
+    n(size),
+    keys(size),
+    probes(ops),
+    zipfProbes(ops),
+    mixDraws(ops)
+{
+    mt19937_64 rng(97);
+    // Multiplying by an odd constant scatters 0..n-1 without collisions
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = i * 0x9e3779b97f4a7c15ULL;
+    }
+    shuffle(keys.begin(), keys.end(), rng);
+
+    // keys is in random order, so popular ranks land all over the tree
+    ZipfSampler zipf(n, ZIPF_EXPONENT);
+    for(size_t i = 0; i < ops; ++i) {
+        probes[i] = keys[rng() % n];
+        zipfProbes[i] = keys[zipf(rng) - 1];
+        mixDraws[i] = rng();
+    }
+    removeOrder = keys;
+    shuffle(removeOrder.begin(), removeOrder.end(), rng);
+}
+
+/**
+* Times n inserts of keys 0..n-1, ascending or descending, into an empty
+* tree.
+*/
+template<typename Tree>
+void benchSortedInsert(const string& name, size_t n, bool ascending, bool degenerates)
+{
+    const string workload = ascending ? "insert sequential" : "insert reverse";
+    if(degenerates && n > DEGENERATE_MAX) {
+        reportSkipped(name, workload, n, "unbalanced, quadratic");
+        return;
+    }
+    Tree tree;
+    BenchTimer timer;
+    for(size_t i = 0; i < n; ++i) {
+        putItem(tree, ascending ? i : n - 1 - i, i);
+    }
+    report(name, workload, n, n, timer.elapsedNs());
+}
+
+/**
+* Times finds of each probe, all of which are present.
+*/
+template<typename Tree>
+void benchFind(const string& name, const string& workload, Tree& tree, size_t n, const vector<uint64_t>& probes)
+{
+    uint64_t sum = 0;
+    BenchTimer timer;
+    for(size_t i = 0; i < probes.size(); ++i) {
+        sum += tree.find(probes[i])->second;
+    }
+    double ns = timer.elapsedNs();
+    benchSink = sum;
+    report(name, workload, n, probes.size(), ns);
+}
+
+/**
+* Runs every workload against one kind of tree. Random inserts build the
+* tree the finds then search; removing every key in a different random
+* order takes it down again. The mixed stream runs on a tree rebuilt from
+* the same keys: half finds, a quarter inserts and a quarter removes, all
+* of keys picked from the workload, so about half of them are present at
+* any time.
+*/
+template<typename Tree>
+void benchStructure(const string& name, const Workload& work, bool degenerates)
+{
+    size_t n = work.n;
+    benchSortedInsert<Tree>(name, n, true, degenerates);
+    benchSortedInsert<Tree>(name, n, false, degenerates);
+
+    {
+        Tree tree;
+        BenchTimer timer;
+        for(size_t i = 0; i < n; ++i) {
+            putItem(tree, work.keys[i], i);
+        }
+        report(name, "insert random", n, n, timer.elapsedNs());
+
+        benchFind(name, "find random", tree, n, work.probes);
+        ostringstream zipfName;
+        zipfName << "find zipf " << ZIPF_EXPONENT;
+        benchFind(name, zipfName.str(), tree, n, work.zipfProbes);
+
+        BenchTimer removeTimer;
+        for(size_t i = 0; i < n; ++i) {
+            removeKey(tree, work.removeOrder[i]);
+        }
+        report(name, "remove random", n, n, removeTimer.elapsedNs());
+    }
+
+    {
+        Tree tree;
+        for(size_t i = 0; i < n; ++i) {
+            putItem(tree, work.keys[i], i);
+        }
+        uint64_t sum = 0;
+        BenchTimer timer;
+        for(size_t i = 0; i < work.mixDraws.size(); ++i) {
+            uint64_t draw = work.mixDraws[i];
+            uint64_t key = work.keys[(draw >> 2) % n];
+            switch(draw & 3) {
+            case 0:
+                putItem(tree, key, i);
+                break;
+            case 1:
+                removeKey(tree, key);
+                break;
+            default: {
+                typename Tree::iterator it = tree.find(key);
+                if(it != tree.end()) {
+                    sum += it->second;
+                }
+            }
+            }
+        }
+        double ns = timer.elapsedNs();
+        benchSink = sum;
+        report(name, "mixed 50/25/25", n, work.mixDraws.size(), ns);
+    }
+}
+
+/**
+* Parses a comma-separated list of sizes; exits on anything else.
+*/
+vector<size_t> parseSizes(const string& list)
+{
+    vector<size_t> sizes;
+    stringstream in(list);
+    string item;
+    while(getline(in, item, ',')) {
+        char* end;
+        size_t size = strtoul(item.c_str(), &end, 10);
+        if(item.empty() || *end != '\0' || size == 0) {
+            cerr << "bst-compare: bad size '" << item << "'" << endl;
+            exit(1);
+        }
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<size_t> sizes = parseSizes("1000,10000,100000,1000000");
+    size_t ops = 1000000;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--csv") == 0) {
+            csvOutput = true;
+        }
+        else if(strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            sizes = parseSizes(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--ops") == 0 && i + 1 < argc) {
+            ops = strtoul(argv[++i], NULL, 10);
+        }
+        else {
+            cerr << "usage: " << argv[0] << " [--csv] [--sizes n1,n2,...] [--ops n]" << endl;
+            return 1;
+        }
+    }
+    if(ops == 0) {
+        cerr << "bst-compare: --ops must be positive" << endl;
+        return 1;
+    }
+
+    if(csvOutput) {
+        cout << "structure,workload,n,ops,ns_per_op,ops_per_sec" << endl;
+    }
+    for(size_t i = 0; i < sizes.size(); ++i) {
+        Workload work(sizes[i], ops);
+        benchStructure<BinarySearchTree<uint64_t, uint64_t> >("BinarySearchTree", work, true);
+        benchStructure<AVLTree<uint64_t, uint64_t> >("AVLTree", work, false);
+        benchStructure<map<uint64_t, uint64_t> >("std::map", work, false);
+    }
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <map>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
 
@@ -44,5 +45,14 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // Bulk build from sorted input
+    std::vector<std::pair<char,int> > sorted;
+    for(char c = 'a'; c <= 'g'; ++c) {
+        sorted.push_back(std::make_pair(c, c - 'a'));
+    }
+    AVLTree<char,int> bulk(sorted.begin(), sorted.end());
+    cout << "\nAVLTree built from sorted range:" << endl;
+    bulk.print();
+
     return 0;
 }
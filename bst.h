@@ -5,20 +5,35 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <functional>
+#include <memory>
+#include <algorithm>
+#include <new>
+#include <type_traits>
+#include <vector>
+#include <iterator>
+#include <cstddef>
+#include <tuple>
+#include "node_pool.h"
+#include "frozen_index.h"
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * The getters for parent/left/right are not virtual:
+ * node kinds for future search trees, such as Red Black
+ * trees, Splay trees, and AVL trees, hide them with
+ * versions returning their own type, so every step of a
+ * traversal is a plain, inlinable load and nodes carry
+ * no vtable pointer.
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    template<typename... Args>
+    Node(Node<Key, Value>* parent, Args&&... args);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,9 +41,9 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
@@ -61,6 +76,22 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
 
 }
 
+/**
+* In-place constructor: the item is built directly from args
+* (anything std::pair<const Key, Value> can be constructed from),
+* so keys and values are moved or constructed exactly once.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+Node<Key, Value>::Node(Node<Key, Value>* parent, Args&&... args) :
+    item_(std::forward<Args>(args)...),
+    parent_(parent),
+    left_(NULL),
+    right_(NULL)
+{
+
+}
+
 /**
 * Destructor, which does not need to do anything since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
@@ -118,7 +149,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -127,7 +158,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +167,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -189,21 +220,26 @@ void Node<Key, Value>::setValue(const Value& value)
 /**
 * A templated unbalanced binary search tree.
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& comp);
     virtual ~BinarySearchTree(); //TODO
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    virtual void insert(std::pair<const Key, Value>&& keyValuePair);
     virtual void remove(const Key& key); //TODO
     void clear(); //TODO
     bool isBalanced() const; //TODO
+    virtual int height() const;
     void print() const;
     bool empty() const;
+    Compare keyCompare() const;
+    FrozenIndex<Key, Value, Compare> freeze() const;
 
-    template<typename PPKey, typename PPValue>
-    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
+    template<typename PPKey, typename PPValue, typename PPCompare>
+    friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue, PPCompare> & tree);
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
@@ -211,6 +247,12 @@ public:
     class iterator  // TODO
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
         iterator();
 
         std::pair<const Key,Value>& operator*() const;
@@ -220,24 +262,112 @@ public:
         bool operator!=(const iterator& rhs) const;
 
         iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
+        friend class BinarySearchTree<Key, Value, Compare>;
         iterator(Node<Key,Value>* ptr);
+        iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value, Compare>* tree);
         Node<Key, Value> *current_;
+        // needed to step back from end(), where current_ is NULL
+        const BinarySearchTree<Key, Value, Compare>* tree_;
     };
 
+    /**
+    * A read-only counterpart of iterator; any iterator converts to one.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare>;
+        const Node<Key, Value> *current_;
+        const BinarySearchTree<Key, Value, Compare>* tree_;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
 public:
     iterator begin() const;
     iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
     iterator find(const Key& key) const;
+
+    // In-place insertion; like std::map these never overwrite an existing value
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> tryEmplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> tryEmplace(Key&& key, Args&&... args);
+
+    // Ordered queries; range scans cost O(log n + items visited)
+    iterator lowerBound(const Key& key) const;
+    iterator upperBound(const Key& key) const;
+    iterator floor(const Key& key) const;
+    iterator ceiling(const Key& key) const;
+    std::pair<iterator, iterator> equalRange(const Key& lo, const Key& hi) const;
+    virtual size_t countRange(const Key& lo, const Key& hi) const;
+
+    // Heterogeneous lookups, available when Compare declares is_transparent
+    // (e.g. std::less<>), so a string-keyed tree can be probed with a
+    // std::string_view or const char* without building a temporary Key
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator lowerBound(const K& key) const;
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator upperBound(const K& key) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
 protected:
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
+    // Descents making one key comparison per level; K is Key unless the
+    // comparator is transparent
+    template<typename K>
+    Node<Key, Value>* internalFindAs(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* internalFindAs(const K& key, std::true_type scalarKeys) const;
+    template<typename K>
+    Node<Key, Value>* internalFindAs(const K& key, std::false_type scalarKeys) const;
+    template<typename K>
+    Node<Key, Value>* internalLowerBound(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* internalUpperBound(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* internalFloor(const K& key) const;
     Node<Key, Value> *getSmallestNode() const;  // TODO
+    Node<Key, Value> *getLargestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
@@ -251,12 +381,41 @@ protected:
     void deleteTree(Node<Key,Value>* root);
 		Node<Key, Value> *getSmallestNode(Node<Key, Value>* root) const;
 		int treeHeight(Node<Key, Value>* root) const; 
+    int heightAndBalance(Node<Key, Value>* root, bool& balanced) const;
 		static Node<Key, Value>* successor(Node<Key, Value>* current);
 
+    // Iterator access for derived trees (iterator only befriends this class)
+    iterator makeIterator(Node<Key, Value>* node) const;
+    static Node<Key, Value>* iteratorNode(const iterator& it);
+
+    // Node storage, shared by all node kinds built on this tree
+    BinarySearchTree(std::size_t nodeSize, std::size_t nodeAlign, const Compare& comp = Compare());
+    Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    template<typename NodeType, typename... Args>
+    NodeType* constructNode(Node<Key, Value>* parent, Args&&... args);
+
+    // Insertion shared by all trees; NodeType is the kind of node to create
+    Node<Key, Value>* findInsertSlot(const Key& key, Node<Key, Value>*& parent, bool& goLeft) const;
+    void linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool goLeft);
+    virtual void afterInsert(Node<Key, Value>* node);
+    template<typename NodeType, typename Item>
+    void insertItem(Item&& item);
+    template<typename NodeType, typename... Args>
+    std::pair<iterator, bool> emplaceItem(Args&&... args);
+    template<typename NodeType, typename K, typename... Args>
+    std::pair<iterator, bool> tryEmplaceItem(K&& key, Args&&... args);
+    virtual void destroyNode(Node<Key, Value>* node);
+    void adoptPoolsOf(const BinarySearchTree<Key, Value, Compare>& other);
+
 
 protected:
     Node<Key, Value>* root_;
-    // You should not need other data members
+    // New nodes come from pool_, which no other tree allocates from. Nodes
+    // moved in from other trees (split/join) stay in their original pools,
+    // which adoptedPools_ keeps alive for as long as this tree may hold them.
+    std::shared_ptr<NodePool> pool_;
+    std::vector<std::shared_ptr<NodePool> > adoptedPools_;
+    Compare comp_;
 		//virtual Node<Key, Value>* successor(Node<Key, Value>* current);
 };
 
@@ -269,30 +428,43 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(Node<Key,Value> *ptr)
 {
     //TODO
 		current_ = ptr;
+		tree_ = nullptr;
+}
+
+/**
+* Constructor that also records the owning tree, so that the
+* iterator can be decremented from end().
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(Node<Key,Value> *ptr, const BinarySearchTree<Key, Value, Compare>* tree)
+{
+		current_ = ptr;
+		tree_ = tree;
 }
 
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator() 
 {
     // TODO
 		current_ = nullptr;
+		tree_ = nullptr;
 
 }
 
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -300,9 +472,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -311,10 +483,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     return (current_ == rhs.current_);
 }
@@ -323,10 +495,10 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     return (current_ != rhs.current_);
 
@@ -336,9 +508,9 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator++()
 {
 	Node<Key,Value>* curr = current_;
 	current_ = successor(curr);
@@ -346,9 +518,50 @@ BinarySearchTree<Key, Value>::iterator::operator++()
 
 }
 
-template<class Key, class Value>
+/**
+* Post-increment; returns the iterator's previous position
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator::operator++(int)
+{
+	iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/**
+* Moves the iterator back using an in-order sequencing.
+* Decrementing end() yields the largest item.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator--()
+{
+	if (current_ == nullptr){
+		current_ = (tree_ == nullptr) ? nullptr : tree_->getLargestNode();
+	}
+	else{
+		current_ = predecessor(current_);
+	}
+	return *this;
+}
+
+/**
+* Post-decrement; returns the iterator's previous position
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator::operator--(int)
+{
+	iterator old(*this);
+	--(*this);
+	return old;
+}
+
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::successor(Node<Key, Value>* current)
 {
 	if (current == nullptr) {
     return nullptr;
@@ -373,6 +586,109 @@ BinarySearchTree<Key, Value>::successor(Node<Key, Value>* current)
 
 
 
+/**
+* A default constructor that initializes the iterator to NULL.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::const_iterator::const_iterator() :
+    current_(nullptr),
+    tree_(nullptr)
+{
+
+}
+
+/**
+* Converting constructor from a mutable iterator.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::const_iterator::const_iterator(const iterator& it) :
+    current_(it.current_),
+    tree_(it.tree_)
+{
+
+}
+
+/**
+* Provides read-only access to the item.
+*/
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> &
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return current_->getItem();
+}
+
+/**
+* Provides the address of the item.
+*/
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> *
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return &(current_->getItem());
+}
+
+template<class Key, class Value, class Compare>
+bool
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::const_iterator& rhs) const
+{
+    return (current_ == rhs.current_);
+}
+
+template<class Key, class Value, class Compare>
+bool
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::const_iterator& rhs) const
+{
+    return (current_ != rhs.current_);
+}
+
+/**
+* Advances using the same in-order sequencing as iterator
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator&
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator++()
+{
+	current_ = successor(const_cast<Node<Key, Value>*>(current_));
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/**
+* Moves back using the same in-order sequencing as iterator
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator&
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator--()
+{
+	if (current_ == nullptr){
+		current_ = (tree_ == nullptr) ? nullptr : tree_->getLargestNode();
+	}
+	else{
+		current_ = predecessor(const_cast<Node<Key, Value>*>(current_));
+	}
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator--(int)
+{
+	const_iterator old(*this);
+	--(*this);
+	return old;
+}
+
 /*
 -------------------------------------------------------------
 End implementations for the BinarySearchTree::iterator class.
@@ -388,14 +704,43 @@ Begin implementations for the BinarySearchTree class.
 /**
 * Default constructor for a BinarySearchTree, which sets the root to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree():root_(nullptr) 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree():
+    root_(nullptr),
+    pool_(std::make_shared<NodePool>(sizeof(Node<Key, Value>), alignof(Node<Key, Value>))),
+    comp_()
 {
     // TODO
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+/**
+* Constructor for a tree ordered by the given comparator object.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(const Compare& comp):
+    root_(nullptr),
+    pool_(std::make_shared<NodePool>(sizeof(Node<Key, Value>), alignof(Node<Key, Value>))),
+    comp_(comp)
+{
+
+}
+
+/**
+* Constructor for derived trees whose nodes are larger than a plain Node.
+* Every node the tree creates is carved out of pool_, so the pool has to be
+* sized for the derived node type.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(std::size_t nodeSize, std::size_t nodeAlign, const Compare& comp):
+    root_(nullptr),
+    pool_(std::make_shared<NodePool>(nodeSize, nodeAlign)),
+    comp_(comp)
+{
+
+}
+
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::~BinarySearchTree()
 {
     // TODO
 		clear();
@@ -405,14 +750,33 @@ BinarySearchTree<Key, Value>::~BinarySearchTree()
 /**
  * Returns true if tree is empty
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::empty() const
 {
     return root_ == NULL;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+/**
+ * Returns a copy of the comparator ordering the keys
+*/
+template<class Key, class Value, class Compare>
+Compare BinarySearchTree<Key, Value, Compare>::keyCompare() const
+{
+    return comp_;
+}
+
+/**
+* Returns a read-only, pointer-free copy of the tree for lookup-heavy use;
+* the tree itself is unchanged and stays independent of the copy.
+*/
+template<class Key, class Value, class Compare>
+FrozenIndex<Key, Value, Compare> BinarySearchTree<Key, Value, Compare>::freeze() const
+{
+    return FrozenIndex<Key, Value, Compare>(cbegin(), cend(), comp_);
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::print() const
 {
     printRoot(root_);
     std::cout << "\n";
@@ -421,51 +785,199 @@ void BinarySearchTree<Key, Value>::print() const
 /**
 * Returns an iterator to the "smallest" item in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value, Compare>::iterator begin(getSmallestNode(), this);
     return begin;
 }
 
 /**
 * Returns an iterator whose value means INVALID
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value, Compare>::iterator end(NULL, this);
     return end;
 }
 
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::cbegin() const
+{
+    return begin();
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::cend() const
+{
+    return end();
+}
+
+/**
+* Returns a reverse iterator to the largest item; walking it
+* visits the items from largest to smallest
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rbegin() const
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rend() const
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare>::crbegin() const
+{
+    return const_reverse_iterator(cend());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare>::crend() const
+{
+    return const_reverse_iterator(cbegin());
+}
+
 /**
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const Key & k) const
 {
     Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    BinarySearchTree<Key, Value, Compare>::iterator it(curr, this);
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or the end iterator if there is none
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lowerBound(const Key& key) const
+{
+    return makeIterator(internalLowerBound(key));
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or the end iterator if there is none
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::upperBound(const Key& key) const
+{
+    return makeIterator(internalUpperBound(key));
+}
+
+/**
+* Returns an iterator to the item with the largest key not greater than key,
+* or the end iterator if every key is greater
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::floor(const Key& key) const
+{
+    return makeIterator(internalFloor(key));
+}
+
+/**
+* Returns an iterator to the item with the smallest key not less than key,
+* or the end iterator if every key is less (same item as lowerBound)
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::ceiling(const Key& key) const
+{
+    return makeIterator(internalLowerBound(key));
+}
+
+/**
+* Returns the iterators [first, last) covering every key in [lo, hi].
+* An empty range (end, end) is returned if hi < lo.
+*/
+template<class Key, class Value, class Compare>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator,
+          typename BinarySearchTree<Key, Value, Compare>::iterator>
+BinarySearchTree<Key, Value, Compare>::equalRange(const Key& lo, const Key& hi) const
+{
+    if (comp_(hi, lo)) {
+        return std::make_pair(end(), end());
+    }
+    return std::make_pair(lowerBound(lo), upperBound(hi));
+}
+
+/**
+* Returns the number of keys in [lo, hi]. Walks the range, so this costs
+* O(log n + count); trees that keep subtree sizes override it.
+*/
+template<class Key, class Value, class Compare>
+size_t BinarySearchTree<Key, Value, Compare>::countRange(const Key& lo, const Key& hi) const
+{
+    std::pair<iterator, iterator> range = equalRange(lo, hi);
+    size_t count = 0;
+    for (iterator it = range.first; it != range.second; ++it) {
+        ++count;
+    }
+    return count;
+}
+
+/**
+* Transparent find(): probes with any type the comparator can order
+* against Key
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const K& key) const
+{
+    return makeIterator(internalFindAs(key));
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lowerBound(const K& key) const
+{
+    return makeIterator(internalLowerBound(key));
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::upperBound(const K& key) const
+{
+    return makeIterator(internalUpperBound(key));
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
  */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+template<class Key, class Value, class Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const Key& key)
 {
     Node<Key, Value> *curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
     return curr->getValue();
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+template<class Key, class Value, class Compare>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const Key& key) const
 {
     Node<Key, Value> *curr = internalFind(key);
     if(curr == NULL) throw std::out_of_range("Invalid key");
@@ -478,47 +990,178 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 * Recall: If key is already in the tree, you should 
 * overwrite the current value with the updated value.
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    insertItem<Node<Key, Value> >(keyValuePair);
+}
+
+/**
+* Same as above, but moves the value (and, when a node is created, the
+* pair) out of keyValuePair instead of copying it.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(std::pair<const Key, Value> &&keyValuePair)
 {
-    Node<Key,Value>* curr = root_;
-		Node<Key,Value>* parent = nullptr;
+    insertItem<Node<Key, Value> >(std::move(keyValuePair));
+}
 
-		Key key_ = keyValuePair.first;
-		Value value_ = keyValuePair.second;
+/**
+* Builds a key/value pair from args in a new node and links it in,
+* unless the key is already present, in which case the tree is left
+* unchanged. Returns the item's position and whether it was inserted.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+    return emplaceItem<Node<Key, Value> >(std::forward<Args>(args)...);
+}
 
-		if(empty() == true){
-			root_ = new Node<Key,Value>(key_,value_,nullptr);
+/**
+* Inserts key with a value constructed in place from args, but only
+* if key is absent; otherwise nothing (not even the value) is built.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::tryEmplace(const Key& key, Args&&... args)
+{
+    return tryEmplaceItem<Node<Key, Value> >(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::tryEmplace(Key&& key, Args&&... args)
+{
+    return tryEmplaceItem<Node<Key, Value> >(std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Descends from the root looking for key, comparing against each node's
+* key by reference. Returns the node holding key if there is one; otherwise
+* returns NULL and leaves parent/goLeft describing where a node for key
+* would be linked (parent is NULL for an empty tree).
+* Each level costs one comparison: the walk always reaches the bottom,
+* remembering the last node not less than key, which is the only node
+* that can be equal to it.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findInsertSlot(const Key& key, Node<Key, Value>*& parent, bool& goLeft) const
+{
+	Node<Key, Value>* curr = root_;
+	Node<Key, Value>* candidate = nullptr;
+	parent = nullptr;
+	goLeft = false;
+	while (curr != nullptr){
+		parent = curr;
+		if (comp_(curr->getKey(), key)){
+			goLeft = false;
+			curr = curr->getRight();
 		}
 		else{
-			bool loc;
-			while (curr != nullptr){
-				Key curr_ = curr -> getKey();
-				parent = curr;
-				if (key_ < curr_){
-					curr = curr -> getLeft();
-					loc = true;
-				}
-				else if (key_ > curr_){
-					curr = curr -> getRight();
-					loc = false;
-				}
-				else if (key_ == curr_){
-					curr -> setValue(value_);
-					return;
-				}
-			}
-
-			curr = new Node<Key, Value>(key_, value_, parent);
-			if (loc == true){
-				parent -> setLeft(curr);
-			}
-			else{
-				parent -> setRight(curr);
-			}
+			candidate = curr;
+			goLeft = true;
+			curr = curr->getLeft();
 		}
+	}
+	if (candidate != nullptr && !comp_(key, candidate->getKey())){
+		return candidate;
+	}
+	return nullptr;
+}
+
+/**
+* Hangs node below parent (or makes it the root) and gives derived
+* trees a chance to restore their invariants.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool goLeft)
+{
+	if (parent == nullptr){
+		root_ = node;
+	}
+	else if (goLeft){
+		parent->setLeft(node);
+	}
+	else{
+		parent->setRight(node);
+	}
+	afterInsert(node);
+}
+
+/**
+* Called once a new node has been linked in. A plain BST has nothing to fix.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
+{
+
+}
+
+/**
+* insert() for any node kind: overwrites the value of an existing key,
+* otherwise creates a NodeType from item after a single descent.
+*/
+template<class Key, class Value, class Compare>
+template<typename NodeType, typename Item>
+void BinarySearchTree<Key, Value, Compare>::insertItem(Item&& item)
+{
+	Node<Key, Value>* parent;
+	bool goLeft;
+	Node<Key, Value>* existing = findInsertSlot(item.first, parent, goLeft);
+	if (existing != nullptr){
+		existing->getValue() = std::forward<Item>(item).second;
 		return;
+	}
+	NodeType* node = constructNode<NodeType>(parent, std::forward<Item>(item));
+	linkNode(node, parent, goLeft);
+}
 
+/**
+* emplace() for any node kind. The pair has to exist before its key can be
+* searched for, so the node is built first and discarded if the key is taken.
+*/
+template<class Key, class Value, class Compare>
+template<typename NodeType, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::emplaceItem(Args&&... args)
+{
+	NodeType* node = constructNode<NodeType>(nullptr, std::forward<Args>(args)...);
+	Node<Key, Value>* parent;
+	bool goLeft;
+	Node<Key, Value>* existing = findInsertSlot(node->getKey(), parent, goLeft);
+	if (existing != nullptr){
+		destroyNode(node);
+		return std::make_pair(makeIterator(existing), false);
+	}
+	node->setParent(parent);
+	linkNode(node, parent, goLeft);
+	return std::make_pair(makeIterator(node), true);
+}
+
+/**
+* tryEmplace() for any node kind: searches with the caller's key, and only
+* constructs the pair (key forwarded, value built from args) on a miss.
+*/
+template<class Key, class Value, class Compare>
+template<typename NodeType, typename K, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::tryEmplaceItem(K&& key, Args&&... args)
+{
+	Node<Key, Value>* parent;
+	bool goLeft;
+	Node<Key, Value>* existing = findInsertSlot(key, parent, goLeft);
+	if (existing != nullptr){
+		return std::make_pair(makeIterator(existing), false);
+	}
+	NodeType* node = constructNode<NodeType>(parent, std::piecewise_construct,
+		std::forward_as_tuple(std::forward<K>(key)),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	linkNode(node, parent, goLeft);
+	return std::make_pair(makeIterator(node), true);
 }
 
 
@@ -527,8 +1170,8 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 * Recall: The writeup specifies that if a node has 2 children you
 * should swap with the predecessor and then remove.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::remove(const Key& key)
 {
     // TODO
     Node<Key, Value>* curr = internalFind(key);
@@ -562,7 +1205,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
       else if (isRoot) {
 				root_=nullptr;
 			}
-      delete curr;
+      destroyNode(curr);
     }
 		else if(curr->getLeft()==nullptr){
       child = curr->getRight();
@@ -576,7 +1219,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         root_ = child;
       }
       child->setParent(parent);
-      delete curr;
+      destroyNode(curr);
     }	
 		else if(curr->getRight()==nullptr){
   		child = curr->getLeft();
@@ -590,7 +1233,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         root_ = child;
       }
       child->setParent(parent);
-      delete curr;
+      destroyNode(curr);
     }
 		else{
       Node<Key, Value>* pred = predecessor(curr);
@@ -606,70 +1249,180 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
       if (child != nullptr){
         child->setParent(parent);
       }
-      delete curr;
+      destroyNode(curr);
     }
 }
 
 
 
-template<class Key, class Value>
+/**
+* Returns the in-order predecessor of current, or NULL if current holds
+* the smallest key. Mirrors successor().
+*/
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::predecessor(Node<Key, Value>* current)
 {
     Node<Key, Value>* curr = current;
-		if (curr == nullptr || curr -> getLeft() == nullptr){
+		if (curr == nullptr){
 			return nullptr;
 		}
-		else{
+		else if (curr -> getLeft() != nullptr){
 			curr = curr -> getLeft();
-			while (curr -> getRight() != nullptr){ // change?
+			while (curr -> getRight() != nullptr){
 				curr = curr -> getRight();
 			}
 			return curr;
 		}
+		else{
+			Node<Key, Value>* node = curr -> getParent();
+			while (node != nullptr && curr == node -> getLeft()){
+				curr = node;
+				node = node -> getParent();
+			}
+			return node;
+		}
 }
 
 
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
+* When the items need no destructor the nodes are never visited:
+* the pool hands its chunks back wholesale.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::clear()
 {
-    deleteTree(root_);
+		if (!std::is_trivially_destructible<std::pair<const Key, Value> >::value){
+			deleteTree(root_);
+		}
+		if (pool_.use_count() == 1){
+			pool_->release();
+		}
+		else{
+			// another tree still holds nodes from our pool; leave it to them
+			pool_ = std::make_shared<NodePool>(pool_->blockSize(), pool_->blockAlign());
+		}
+		adoptedPools_.clear();
 		root_ = NULL;
 		return;
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::deleteTree(Node<Key,Value>* root){
-	if(root == nullptr){ // base case
-        return;
-    }
-    
-	// recursively delete left and right subtrees
-	deleteTree(root->getLeft());
-	deleteTree(root->getRight());
-	
-	// delete current node
-	delete root;
+/**
+* Destroys every node below and including root. Rather than recursing,
+* which could overflow the stack on a long path (a plain BST filled in
+* order, or a SplayTree), it rotates each left child up until the top
+* node has none, then destroys it and moves on to its right child.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::deleteTree(Node<Key,Value>* root){
+	while (root != nullptr){
+		Node<Key, Value>* left = root->getLeft();
+		if (left != nullptr){
+			root->setLeft(left->getRight());
+			left->setRight(root);
+			root = left;
+		}
+		else{
+			Node<Key, Value>* right = root->getRight();
+			destroyNode(root);
+			root = right;
+		}
+	}
+}
+
+/**
+* Wraps a node of this tree in an iterator.
+*/
+template<typename Key, typename Value, typename Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::makeIterator(Node<Key, Value>* node) const
+{
+	return iterator(node, this);
+}
+
+/**
+* Returns the node an iterator points at (NULL for end()).
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::iteratorNode(const iterator& it)
+{
+	return it.current_;
+}
+
+/**
+* Builds a node in a block taken from the tree's pool.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+	return constructNode<Node<Key, Value> >(parent, key, value);
+}
+
+/**
+* Builds a NodeType in a block taken from the tree's pool, forwarding args
+* to its in-place constructor. The block is returned if construction throws.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename NodeType, typename... Args>
+NodeType* BinarySearchTree<Key, Value, Compare>::constructNode(Node<Key, Value>* parent, Args&&... args)
+{
+	void* block = pool_->allocate();
+	try {
+		return new (block) NodeType(static_cast<NodeType*>(parent), std::forward<Args>(args)...);
+	}
+	catch (...) {
+		pool_->deallocate(block);
+		throw;
+	}
+}
+
+/**
+* Destroys a node and hands its block back to the pool's free list.
+* Node has no virtual destructor, so trees with larger node kinds
+* override this to run the right one.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+	node->~Node();
+	pool_->deallocate(node);
+}
+
+/**
+* Makes this tree share ownership of every pool other's nodes may live in,
+* before some of those nodes are moved over. Freed nodes still go onto
+* this tree's own free list, so blocks never return to a shared pool.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::adoptPoolsOf(const BinarySearchTree<Key, Value, Compare>& other)
+{
+	std::vector<std::shared_ptr<NodePool> > incoming(other.adoptedPools_);
+	incoming.push_back(other.pool_);
+	for (size_t i = 0; i < incoming.size(); ++i){
+		if (incoming[i] == pool_ ||
+			std::find(adoptedPools_.begin(), adoptedPools_.end(), incoming[i]) != adoptedPools_.end()){
+			continue;
+		}
+		adoptedPools_.push_back(incoming[i]);
+	}
 }
 
 
 /**
 * A helper function to find the smallest node in the tree.
 */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+BinarySearchTree<Key, Value, Compare>::getSmallestNode() const
 {
   return getSmallestNode(root_);
 }
 
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode(Node<Key, Value>* root) const{
+BinarySearchTree<Key, Value, Compare>::getSmallestNode(Node<Key, Value>* root) const{
 	if (root == nullptr){
 		return nullptr;
 	}
@@ -681,83 +1434,222 @@ BinarySearchTree<Key, Value>::getSmallestNode(Node<Key, Value>* root) const{
 
 }
 
+/**
+* A helper function to find the largest node in the tree.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::getLargestNode() const
+{
+	Node<Key, Value>* curr = root_;
+	while (curr != nullptr && curr -> getRight() != nullptr){
+		curr = curr -> getRight();
+	}
+	return curr;
+}
+
 /**
 * Helper function to find a node with given key, k and
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFind(const Key& key) const
 {
-    Node<Key, Value>* curr = root_;
-		if (curr == nullptr){
-			return nullptr;
+    return internalFindAs(key);
+}
+
+/**
+* internalFind() for any key type the comparator accepts. Scalar keys
+* compare in a single instruction, so they keep the three-way descent that
+* stops at the match; everything else pays for one comparison per level.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFindAs(const K& key) const
+{
+	return internalFindAs(key, std::integral_constant<bool,
+		std::is_scalar<Key>::value && std::is_scalar<K>::value>());
+}
+
+/**
+* Three-way descent: both orders are tested at each level, which the
+* compiler turns into a conditional move instead of a mispredicted branch.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFindAs(const K& key, std::true_type) const
+{
+	Node<Key, Value>* curr = root_;
+	while (curr != nullptr){
+		bool goLeft = comp_(key, curr->getKey());
+		bool goRight = comp_(curr->getKey(), key);
+		if (!goLeft && !goRight){
+			return curr;
 		}
-		while(curr != nullptr && curr -> getKey() != key){
-			if (key < (curr -> getKey())){
-				curr = curr -> getLeft();
-			}
-			else if (key > curr -> getKey()){
-				curr = curr -> getRight();
-			}
-			else if (key == curr -> getKey()){
-				return nullptr;
-			}
+		curr = goLeft ? curr->getLeft() : curr->getRight();
+	}
+	return nullptr;
+}
+
+/**
+* Lower-bound descent (one comparison per level) followed by a single
+* equivalence check on the candidate.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFindAs(const K& key, std::false_type) const
+{
+	Node<Key, Value>* candidate = internalLowerBound(key);
+	if (candidate != nullptr && !comp_(key, candidate->getKey())){
+		return candidate;
+	}
+	return nullptr;
+}
+
+/**
+* Helper function returning the node with the smallest key not less than
+* key, or NULL if every key is less
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalLowerBound(const K& key) const
+{
+	Node<Key, Value>* curr = root_;
+	Node<Key, Value>* best = nullptr;
+	while (curr != nullptr){
+		if (comp_(curr->getKey(), key)){
+			curr = curr->getRight();
 		}
-		return curr;
+		else{
+			best = curr;
+			curr = curr->getLeft();
+		}
+	}
+	return best;
+}
+
+/**
+* Helper function returning the node with the smallest key greater than
+* key, or NULL if no key is greater
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalUpperBound(const K& key) const
+{
+	Node<Key, Value>* curr = root_;
+	Node<Key, Value>* best = nullptr;
+	while (curr != nullptr){
+		if (comp_(key, curr->getKey())){
+			best = curr;
+			curr = curr->getLeft();
+		}
+		else{
+			curr = curr->getRight();
+		}
+	}
+	return best;
+}
+
+/**
+* Helper function returning the node with the largest key not greater than
+* key, or NULL if every key is greater
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFloor(const K& key) const
+{
+	Node<Key, Value>* curr = root_;
+	Node<Key, Value>* best = nullptr;
+	while (curr != nullptr){
+		if (comp_(key, curr->getKey())){
+			curr = curr->getLeft();
+		}
+		else{
+			best = curr;
+			curr = curr->getRight();
+		}
+	}
+	return best;
 }
 
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced() const
 {
     return isBalanced(root_);
 }
 
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced(Node<Key, Value>* root) const {
-    if (root == nullptr) {
-        // An empty tree is always balanced
-        return true;
-    }
-
-    int leftHeight = treeHeight(root->getLeft());
-    int rightHeight = treeHeight(root->getRight());
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced(Node<Key, Value>* root) const {
+    bool balanced = true;
+    heightAndBalance(root, balanced);
+    return balanced;
+}
 
-    // Check if the height difference between the left and right subtrees
-    // is within the allowed range (-1, 0, or 1)
-    int heightDiff = abs(leftHeight - rightHeight);
-    if (heightDiff <= 1 && isBalanced(root->getLeft()) && isBalanced(root->getRight())) {
-        return true;
-    } else {
-        return false;
-    }
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::treeHeight(Node<Key, Value> * root) const{
+	bool balanced = true;
+	return heightAndBalance(root, balanced);
 }
 
-template<typename Key, typename Value>
-int BinarySearchTree<Key, Value>::treeHeight(Node<Key, Value> * root) const{
-	if (root == nullptr){
-		return 0;
-	}
+/**
+ * Returns the number of levels in the tree (0 when empty).
+ */
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::height() const
+{
+    return treeHeight(root_);
+}
 
-	int leftHeight = treeHeight(root -> getLeft());
-	int rightHeight = treeHeight(root -> getRight());
+/**
+ * Computes the height of the subtree at root and, in the same post-order
+ * pass, clears balanced if any node's subtrees differ in height by more
+ * than one. Each node is visited once, and the explicit stack keeps
+ * degenerate (list-shaped) trees from overflowing the call stack.
+ */
+template<typename Key, typename Value, typename Compare>
+int BinarySearchTree<Key, Value, Compare>::heightAndBalance(Node<Key, Value>* root, bool& balanced) const
+{
+	// a node is pushed twice: once to schedule its children, once to combine them
+	std::vector<std::pair<Node<Key, Value>*, bool> > pending;
+	std::vector<int> heights;
+	pending.push_back(std::make_pair(root, false));
 
-	int max = leftHeight;
-	if (rightHeight > leftHeight){
-		max = rightHeight;
-	}
+	while (!pending.empty()){
+		Node<Key, Value>* curr = pending.back().first;
+		bool childrenDone = pending.back().second;
+		pending.pop_back();
 
-	return 1 + max;
+		if (curr == nullptr){
+			heights.push_back(0);
+		}
+		else if (!childrenDone){
+			pending.push_back(std::make_pair(curr, true));
+			pending.push_back(std::make_pair(curr->getRight(), false));
+			pending.push_back(std::make_pair(curr->getLeft(), false));
+		}
+		else{
+			int rightHeight = heights.back();
+			heights.pop_back();
+			int leftHeight = heights.back();
+			heights.pop_back();
 
+			if (abs(leftHeight - rightHeight) > 1){
+				balanced = false;
+			}
+			heights.push_back(1 + std::max(leftHeight, rightHeight));
+		}
+	}
+	return heights.back();
 }
 
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     // If the nodes are the same or either of them is NULL, return
     if (n1 == n2 || n1 == nullptr || n2 == nullptr) {
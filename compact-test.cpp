@@ -0,0 +1,168 @@
+#include <iostream>
+#include <map>
+#include <string>
+#include <random>
+#include <stdexcept>
+#include <cstdint>
+#include "compact_avlbst.h"
+
+using namespace std;
+
+/**
+* Checks CompactAVLTree against std::map under random inserts and
+* removes, and that slots reused from the free list neither leak nor
+* double-destroy their items, even when building an item throws.
+*/
+
+static int failures = 0;
+
+void report(const char* msg, bool ok)
+{
+    cout << msg << ": " << (ok ? "ok" : "FAILED") << endl;
+    if(!ok) {
+        ++failures;
+    }
+}
+
+/**
+* Reports whether tree holds exactly the items of expected, in order,
+* by const and non-const iteration and by find().
+*/
+template<typename Tree, typename Map>
+bool sameContents(Tree& tree, const Map& expected)
+{
+    if(tree.size() != expected.size() || tree.empty() != expected.empty()) {
+        return false;
+    }
+    typename Map::const_iterator want = expected.begin();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want) {
+        if(want == expected.end() || it->first != want->first || it->second != want->second) {
+            return false;
+        }
+    }
+    const Tree& constTree = tree;
+    want = expected.begin();
+    for(typename Tree::const_iterator it = constTree.begin(); it != constTree.end(); ++it, ++want) {
+        if(want == expected.end() || it->first != want->first || it->second != want->second) {
+            return false;
+        }
+    }
+    for(want = expected.begin(); want != expected.end(); ++want) {
+        typename Tree::const_iterator it = constTree.find(want->first);
+        if(it == constTree.end() || it->second != want->second) {
+            return false;
+        }
+    }
+    return want == expected.end();
+}
+
+/**
+* A value that counts live copies and throws from its copy constructor
+* once armed, to catch leaks and double destruction.
+*/
+class Counted
+{
+public:
+    Counted(int value) : value_(value) { ++live; }
+    Counted(const Counted& other) : value_(other.value_)
+    {
+        if(throwOnCopy) {
+            throw runtime_error("copy failed");
+        }
+        ++live;
+    }
+    ~Counted() { --live; }
+    Counted& operator=(const Counted& other) { value_ = other.value_; return *this; }
+    bool operator!=(const Counted& other) const { return value_ != other.value_; }
+
+    static int live;
+    static bool throwOnCopy;
+
+private:
+    int value_;
+};
+
+int Counted::live = 0;
+bool Counted::throwOnCopy = false;
+
+int main()
+{
+    // Random inserts, overwrites and removes against std::map
+    {
+        CompactAVLTree<uint32_t, uint64_t> tree;
+        map<uint32_t, uint64_t> expected;
+        mt19937 rng(18);
+        bool ok = true;
+        bool balanced = true;
+        for(size_t i = 0; i < 200000 && ok; ++i) {
+            uint32_t key = rng() % 5000;
+            if(rng() % 3 == 0) {
+                tree.remove(key);
+                expected.erase(key);
+            }
+            else {
+                uint64_t value = rng();
+                tree.insert(make_pair(key, value));
+                expected[key] = value;
+            }
+            if(i % 10000 == 0) {
+                ok = sameContents(tree, expected);
+                balanced = balanced && tree.isBalanced();
+            }
+        }
+        report("random inserts and removes", ok && sameContents(tree, expected));
+        report("random inserts and removes stay balanced", balanced && tree.isBalanced());
+
+        uint32_t missing = 5000;
+        report("find of a missing key", tree.find(missing) == tree.end());
+
+        tree.begin()->second = 7;
+        expected.begin()->second = 7;
+        tree[expected.rbegin()->first] = 9;
+        expected.rbegin()->second = 9;
+        report("writes through iterator and operator[]", sameContents(tree, expected));
+
+        tree.clear();
+        expected.clear();
+        report("clear", sameContents(tree, expected) && tree.isBalanced());
+    }
+
+    // Removed items are destroyed at once, and a throw while reusing a
+    // free slot leaves the tree and the free list intact
+    {
+        CompactAVLTree<string, Counted> tree;
+        map<string, Counted> expected;
+        for(int i = 0; i < 100; ++i) {
+            tree.insert(make_pair(to_string(i), Counted(i)));
+            expected.insert(make_pair(to_string(i), Counted(i)));
+        }
+        for(int i = 0; i < 100; i += 2) {
+            tree.remove(to_string(i));
+            expected.erase(to_string(i));
+        }
+        report("removes destroy their values", Counted::live == 100);
+
+        bool threw = false;
+        {
+            pair<const string, Counted> item("x", Counted(-1));
+            Counted::throwOnCopy = true;
+            try {
+                tree.insert(item);
+            }
+            catch(const runtime_error&) {
+                threw = true;
+            }
+            Counted::throwOnCopy = false;
+        }
+        report("throwing insert into a free slot", threw && Counted::live == 100 && sameContents(tree, expected));
+
+        for(int i = 0; i < 100; i += 2) {
+            tree.insert(make_pair(to_string(i), Counted(i)));
+            expected.insert(make_pair(to_string(i), Counted(i)));
+        }
+        report("inserts reuse free slots", sameContents(tree, expected) && tree.isBalanced());
+    }
+    report("no values outlive the tree", Counted::live == 0);
+
+    return failures == 0 ? 0 : 1;
+}
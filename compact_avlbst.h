@@ -0,0 +1,1072 @@
+#ifndef COMPACT_AVLBST_H
+#define COMPACT_AVLBST_H
+
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <new>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+/**
+* A node of a CompactAVLTree: the key and value, and two 32-bit links
+* holding 31-bit node indices. The balance factor (-1, 0 or +1, stored
+* offset by one) takes the top bit of each link, so a uint64_t to
+* uint64_t node is 24 bytes.
+*
+* A node can also be a free slot: its key and value are destroyed, and
+* both balance bits are set, a pattern no balance uses. The item lives
+* in unions so that a slot can give it up and take another in place.
+*/
+template <typename Key, typename Value>
+class CompactAVLNode
+{
+public:
+    static const uint32_t NIL = 0x7FFFFFFFu;
+
+    CompactAVLNode(const Key& key, const Value& value);
+    CompactAVLNode(const CompactAVLNode& other);
+    ~CompactAVLNode();
+
+    void setItem(const Key& key, const Value& value);
+    void releaseItem();
+    bool isFree() const;
+
+    const Key& getKey() const;
+    Value& getValue();
+    const Value& getValue() const;
+    void setValue(const Value& value);
+
+    uint32_t getLeft() const;
+    uint32_t getRight() const;
+    uint32_t getChild(bool right) const;
+    void setLeft(uint32_t left);
+    void setRight(uint32_t right);
+
+    int getBalance() const;
+    void setBalance(int balance);
+
+protected:
+    static const uint32_t INDEX_MASK = 0x7FFFFFFFu;
+    static const uint32_t BALANCE_BIT = 0x80000000u;
+
+    union { Key key_; };
+    union { Value value_; };
+    // Left then right link, indexable by a comparison result. The top bit
+    // of each holds the low, then the high, bit of balance + 1.
+    uint32_t links_[2];
+};
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the CompactAVLNode class.
+  -----------------------------------------------------------
+*/
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const Key& key, const Value& value) :
+    key_(key),
+    value_(value)
+{
+    links_[0] = NIL | BALANCE_BIT;
+    links_[1] = NIL;
+}
+
+/**
+* Copies a free slot as a free slot, e.g. when the node vector grows.
+*/
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::CompactAVLNode(const CompactAVLNode& other)
+{
+    links_[0] = other.links_[0];
+    links_[1] = other.links_[1];
+    if (!other.isFree()){
+        new (&key_) Key(other.key_);
+        try {
+            new (&value_) Value(other.value_);
+        }
+        catch (...) {
+            key_.~Key();
+            throw;
+        }
+    }
+}
+
+template<class Key, class Value>
+CompactAVLNode<Key, Value>::~CompactAVLNode()
+{
+    if (!isFree()){
+        releaseItem();
+    }
+}
+
+/**
+* Builds a new item in a free slot and resets its links. If that throws
+* the slot stays free.
+*/
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setItem(const Key& key, const Value& value)
+{
+    new (&key_) Key(key);
+    try {
+        new (&value_) Value(value);
+    }
+    catch (...) {
+        key_.~Key();
+        throw;
+    }
+    links_[0] = NIL | BALANCE_BIT;
+    links_[1] = NIL;
+}
+
+/**
+* Destroys the key and value and marks the slot free; the links keep
+* their indices.
+*/
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::releaseItem()
+{
+    key_.~Key();
+    value_.~Value();
+    links_[0] |= BALANCE_BIT;
+    links_[1] |= BALANCE_BIT;
+}
+
+template<class Key, class Value>
+bool CompactAVLNode<Key, Value>::isFree() const
+{
+    return (links_[0] & links_[1] & BALANCE_BIT) != 0;
+}
+
+template<class Key, class Value>
+const Key& CompactAVLNode<Key, Value>::getKey() const
+{
+    return key_;
+}
+
+template<class Key, class Value>
+Value& CompactAVLNode<Key, Value>::getValue()
+{
+    return value_;
+}
+
+template<class Key, class Value>
+const Value& CompactAVLNode<Key, Value>::getValue() const
+{
+    return value_;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setValue(const Value& value)
+{
+    value_ = value;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLNode<Key, Value>::getLeft() const
+{
+    return links_[0] & INDEX_MASK;
+}
+
+template<class Key, class Value>
+uint32_t CompactAVLNode<Key, Value>::getRight() const
+{
+    return links_[1] & INDEX_MASK;
+}
+
+/**
+* The left child if right is false, else the right child. Indexing rather
+* than choosing keeps a descent free of branches.
+*/
+template<class Key, class Value>
+uint32_t CompactAVLNode<Key, Value>::getChild(bool right) const
+{
+    return links_[right] & INDEX_MASK;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setLeft(uint32_t left)
+{
+    links_[0] = (links_[0] & BALANCE_BIT) | left;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setRight(uint32_t right)
+{
+    links_[1] = (links_[1] & BALANCE_BIT) | right;
+}
+
+template<class Key, class Value>
+int CompactAVLNode<Key, Value>::getBalance() const
+{
+    return static_cast<int>((links_[0] >> 31) | ((links_[1] >> 31) << 1)) - 1;
+}
+
+template<class Key, class Value>
+void CompactAVLNode<Key, Value>::setBalance(int balance)
+{
+    uint32_t bits = static_cast<uint32_t>(balance + 1);
+    links_[0] = (links_[0] & INDEX_MASK) | ((bits & 1) << 31);
+    links_[1] = (links_[1] & INDEX_MASK) | ((bits >> 1) << 31);
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the CompactAVLNode class.
+  ---------------------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes live in one contiguous vector and link to each
+* other by 32-bit index, with no parent links; updates walk down and
+* rebalance on the way back up. For 8-byte keys and values a node is 24
+* bytes against about 56 for AVLNode, and there is no per-node allocation
+* overhead. Call reserve() when the final size is known, or the vector's
+* growth slack eats into the saving.
+*
+* Holds at most 2^31 - 1 items. A removed item is destroyed at once, and
+* its slot is reused by a later insert. Iterators are forward-only and invalidated by any update.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class CompactAVLTree
+{
+protected:
+    typedef CompactAVLNode<Key, Value> NodeType;
+    static const uint32_t NIL = NodeType::NIL;
+    // An AVL tree of fewer than 2^31 nodes is at most 44 levels tall
+    static const size_t MAX_HEIGHT = 48;
+
+public:
+    CompactAVLTree();
+    explicit CompactAVLTree(const Compare& comp);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    void reserve(size_t count);
+
+    size_t size() const;
+    bool empty() const;
+    int height() const;
+    bool isBalanced() const;
+    size_t memoryUsage() const;
+    Compare keyCompare() const;
+
+    /**
+    * An in-order iterator carrying its own path, since nodes have no
+    * parent links; the path is a fixed array, so making and copying an
+    * iterator never allocates. *it is a pair of references to the key
+    * and value, read-only here; iterator adds write access.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key&, const Value&> reference;
+
+        /**
+        * Lets it->first and it->second work on the reference pair.
+        */
+        class pointer
+        {
+        public:
+            explicit pointer(const reference& item) : item_(item) {}
+            const reference* operator->() const { return &item_; }
+        private:
+            reference item_;
+        };
+
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+    protected:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        void pushLeftSpine(uint32_t node);
+
+        // Nodes whose items are still ahead, nearest last
+        uint32_t path_[MAX_HEIGHT];
+        size_t depth_;
+        bool partial_;      // path_ holds only the current node so far
+        const CompactAVLTree<Key, Value, Compare>* tree_;
+    };
+
+    /**
+    * A const_iterator that can also write the value. Only a non-const
+    * tree hands these out; each converts to a const_iterator.
+    */
+    class iterator : public const_iterator
+    {
+    public:
+        typedef std::pair<const Key&, Value&> reference;
+
+        /**
+        * Lets it->first and it->second work on the reference pair.
+        */
+        class pointer
+        {
+        public:
+            explicit pointer(const reference& item) : item_(item) {}
+            reference* operator->() { return &item_; }
+        private:
+            reference item_;
+        };
+
+        iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        iterator& operator++();
+        iterator operator++(int);
+
+    protected:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        explicit iterator(const const_iterator& it);
+    };
+
+    iterator begin();
+    iterator end();
+    iterator find(const Key& key);
+    iterator lowerBound(const Key& key);
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lowerBound(const Key& key) const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    const_iterator find(const Key& key, std::true_type scalarKeys) const;
+    const_iterator find(const Key& key, std::false_type scalarKeys) const;
+    uint32_t findIndex(const Key& key) const;
+    uint32_t findIndex(const Key& key, std::true_type scalarKeys) const;
+    uint32_t findIndex(const Key& key, std::false_type scalarKeys) const;
+    uint32_t insertAt(uint32_t node, const std::pair<const Key, Value>& item, bool& grew);
+    uint32_t removeAt(uint32_t node, const Key& key, bool& shrank);
+    uint32_t detachSmallest(uint32_t node, uint32_t& smallest, bool& shrank);
+    uint32_t leftShrank(uint32_t node, bool& shrank);
+    uint32_t rightShrank(uint32_t node, bool& shrank);
+    uint32_t rotateLeft(uint32_t node, int balance);
+    uint32_t rotateRight(uint32_t node, int balance);
+    uint32_t rebalance(uint32_t node, int balance);
+    uint32_t newNode(const std::pair<const Key, Value>& item);
+    void freeNode(uint32_t node);
+    bool checkBalance(uint32_t node, int& height) const;
+
+    std::vector<NodeType> nodes_;
+    uint32_t root_;
+    uint32_t freeList_;     // unused slots, chained through their left links
+    size_t size_;
+    Compare comp_;
+};
+
+/*
+  ------------------------------------------------------------------
+  Begin implementations for the CompactAVLTree::const_iterator class.
+  ------------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::const_iterator::const_iterator() :
+    depth_(0),
+    partial_(false),
+    tree_(NULL)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator::reference
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    const NodeType& node = tree_->nodes_[path_[depth_ - 1]];
+    return reference(node.getKey(), node.getValue());
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator::pointer
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return pointer(**this);
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    if (depth_ == 0 || rhs.depth_ == 0){
+        return depth_ == rhs.depth_;
+    }
+    return path_[depth_ - 1] == rhs.path_[rhs.depth_ - 1];
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator&
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator++()
+{
+	if (partial_){
+		*this = tree_->lowerBound(tree_->nodes_[path_[0]].getKey());
+	}
+	uint32_t node = path_[--depth_];
+	pushLeftSpine(tree_->nodes_[node].getRight());
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
+}
+
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::const_iterator::pushLeftSpine(uint32_t node)
+{
+	for (; node != NIL; node = tree_->nodes_[node].getLeft()){
+		path_[depth_++] = node;
+	}
+}
+
+/*
+  ----------------------------------------------------------------
+  End implementations for the CompactAVLTree::const_iterator class.
+  ----------------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------------------
+  Begin implementations for the CompactAVLTree::iterator class.
+  ------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator() :
+    const_iterator()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator(const const_iterator& it) :
+    const_iterator(it)
+{
+
+}
+
+/**
+* The tree is non-const: it handed out this iterator from a non-const
+* member, so writing through the node is allowed.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator::reference
+CompactAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    NodeType& node = const_cast<NodeType&>(this->tree_->nodes_[this->path_[this->depth_ - 1]]);
+    return reference(node.getKey(), node.getValue());
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator::pointer
+CompactAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return pointer(**this);
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+	const_iterator::operator++();
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::iterator::operator++(int)
+{
+	iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/*
+  ----------------------------------------------------------
+  End implementations for the CompactAVLTree::iterator class.
+  ----------------------------------------------------------
+*/
+
+/*
+  ------------------------------------------------------
+  Begin implementations for the CompactAVLTree class.
+  ------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree() :
+    root_(NIL),
+    freeList_(NIL),
+    size_(0),
+    comp_()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(const Compare& comp) :
+    root_(NIL),
+    freeList_(NIL),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is present.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	bool grew = false;
+	root_ = insertAt(root_, keyValuePair, grew);
+}
+
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+	bool shrank = false;
+	root_ = removeAt(root_, key, shrank);
+}
+
+/**
+* Removes every item and gives the node storage back.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::clear()
+{
+	std::vector<NodeType>().swap(nodes_);
+	root_ = NIL;
+	freeList_ = NIL;
+	size_ = 0;
+}
+
+/**
+* Sizes the node storage for count items up front, so it holds exactly
+* that many nodes instead of growing by doubling.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::reserve(size_t count)
+{
+	nodes_.reserve(count);
+}
+
+template<class Key, class Value, class Compare>
+size_t CompactAVLTree<Key, Value, Compare>::size() const
+{
+	return size_;
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::empty() const
+{
+	return root_ == NIL;
+}
+
+template<class Key, class Value, class Compare>
+int CompactAVLTree<Key, Value, Compare>::height() const
+{
+	int height = 0;
+	for (uint32_t node = root_; node != NIL; ++height){
+		node = (nodes_[node].getBalance() > 0) ? nodes_[node].getRight() : nodes_[node].getLeft();
+	}
+	return height;
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::isBalanced() const
+{
+	int height;
+	return checkBalance(root_, height);
+}
+
+/**
+* Bytes held for node storage, including unused capacity.
+*/
+template<class Key, class Value, class Compare>
+size_t CompactAVLTree<Key, Value, Compare>::memoryUsage() const
+{
+	return nodes_.capacity() * sizeof(NodeType);
+}
+
+template<class Key, class Value, class Compare>
+Compare CompactAVLTree<Key, Value, Compare>::keyCompare() const
+{
+	return comp_;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::begin()
+{
+	return iterator(cbegin());
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::end()
+{
+	return iterator(cend());
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key)
+{
+	return iterator(static_cast<const CompactAVLTree<Key, Value, Compare>*>(this)->find(key));
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::lowerBound(const Key& key)
+{
+	return iterator(static_cast<const CompactAVLTree<Key, Value, Compare>*>(this)->lowerBound(key));
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::begin() const
+{
+	return cbegin();
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::end() const
+{
+	return cend();
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::cbegin() const
+{
+	const_iterator it;
+	it.tree_ = this;
+	it.pushLeftSpine(root_);
+	return it;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::cend() const
+{
+	const_iterator it;
+	it.tree_ = this;
+	return it;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+	return find(key, std::integral_constant<bool, std::is_scalar<Key>::value>());
+}
+
+/**
+* Runs the branch-free findIndex() and hands back an iterator holding just
+* the node found; the rest of its path is only filled in if it is moved.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key, std::true_type) const
+{
+	const_iterator it = cend();
+	uint32_t node = findIndex(key);
+	if (node != NIL){
+		it.path_[0] = node;
+		it.depth_ = 1;
+		it.partial_ = true;
+	}
+	return it;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key, std::false_type) const
+{
+	const_iterator it = lowerBound(key);
+	if (it != cend() && comp_(key, it->first)){
+		return cend();
+	}
+	return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key;
+* the nodes we turn left at are exactly the ones still ahead of it. Every
+* node is written to the path and only left turns advance it, so the
+* descent has no data-dependent branch.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::const_iterator
+CompactAVLTree<Key, Value, Compare>::lowerBound(const Key& key) const
+{
+	const_iterator it = cend();
+	const NodeType* nodes = nodes_.data();
+	uint32_t node = root_;
+	while (node != NIL){
+		bool goRight = comp_(nodes[node].getKey(), key);
+		it.path_[it.depth_] = node;
+		it.depth_ += !goRight;
+		node = nodes[node].getChild(goRight);
+	}
+	return it;
+}
+
+template<class Key, class Value, class Compare>
+Value& CompactAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+	uint32_t node = findIndex(key);
+	if (node == NIL) throw std::out_of_range("Invalid key");
+	return nodes_[node].getValue();
+}
+
+template<class Key, class Value, class Compare>
+Value const & CompactAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+	uint32_t node = findIndex(key);
+	if (node == NIL) throw std::out_of_range("Invalid key");
+	return nodes_[node].getValue();
+}
+
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::findIndex(const Key& key) const
+{
+	return findIndex(key, std::integral_constant<bool, std::is_scalar<Key>::value>());
+}
+
+/**
+* Both orders are tested at each level and the next index is picked by
+* the result, so the only branch taken is the one out of the loop.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::findIndex(const Key& key, std::true_type) const
+{
+	const NodeType* nodes = nodes_.data();
+	uint32_t node = root_;
+	while (node != NIL){
+		const NodeType& curr = nodes[node];
+		bool goLeft = comp_(key, curr.getKey());
+		bool goRight = comp_(curr.getKey(), key);
+		if (!goLeft && !goRight){
+			return node;
+		}
+		node = curr.getChild(goRight);
+	}
+	return NIL;
+}
+
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::findIndex(const Key& key, std::false_type) const
+{
+	uint32_t node = root_;
+	while (node != NIL){
+		const NodeType& curr = nodes_[node];
+		if (comp_(key, curr.getKey())){
+			node = curr.getLeft();
+		}
+		else if (comp_(curr.getKey(), key)){
+			node = curr.getRight();
+		}
+		else{
+			return node;
+		}
+	}
+	return NIL;
+}
+
+/**
+* Inserts item below node and returns the subtree's new root; grew says
+* whether the subtree got taller. Nodes are always re-read by index,
+* since newNode() may move the whole vector.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::insertAt(uint32_t node, const std::pair<const Key, Value>& item, bool& grew)
+{
+	if (node == NIL){
+		grew = true;
+		return newNode(item);
+	}
+	if (comp_(item.first, nodes_[node].getKey())){
+		uint32_t left = insertAt(nodes_[node].getLeft(), item, grew);
+		nodes_[node].setLeft(left);
+		if (grew){
+			int balance = nodes_[node].getBalance() - 1;
+			if (balance == -2){
+				grew = false;
+				return rebalance(node, balance);
+			}
+			nodes_[node].setBalance(balance);
+			grew = (balance != 0);
+		}
+		return node;
+	}
+	if (comp_(nodes_[node].getKey(), item.first)){
+		uint32_t right = insertAt(nodes_[node].getRight(), item, grew);
+		nodes_[node].setRight(right);
+		if (grew){
+			int balance = nodes_[node].getBalance() + 1;
+			if (balance == 2){
+				grew = false;
+				return rebalance(node, balance);
+			}
+			nodes_[node].setBalance(balance);
+			grew = (balance != 0);
+		}
+		return node;
+	}
+	nodes_[node].setValue(item.second);
+	grew = false;
+	return node;
+}
+
+/**
+* Removes key from below node and returns the subtree's new root; shrank
+* says whether the subtree got shorter. A node with two children is
+* replaced by its successor node, moved up whole.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::removeAt(uint32_t node, const Key& key, bool& shrank)
+{
+	if (node == NIL){
+		shrank = false;
+		return NIL;
+	}
+	if (comp_(key, nodes_[node].getKey())){
+		nodes_[node].setLeft(removeAt(nodes_[node].getLeft(), key, shrank));
+		return shrank ? leftShrank(node, shrank) : node;
+	}
+	if (comp_(nodes_[node].getKey(), key)){
+		nodes_[node].setRight(removeAt(nodes_[node].getRight(), key, shrank));
+		return shrank ? rightShrank(node, shrank) : node;
+	}
+
+	uint32_t left = nodes_[node].getLeft();
+	uint32_t right = nodes_[node].getRight();
+	if (left == NIL || right == NIL){
+		freeNode(node);
+		shrank = true;
+		return (left != NIL) ? left : right;
+	}
+	uint32_t successor;
+	right = detachSmallest(right, successor, shrank);
+	nodes_[successor].setLeft(left);
+	nodes_[successor].setRight(right);
+	nodes_[successor].setBalance(nodes_[node].getBalance());
+	freeNode(node);
+	return shrank ? rightShrank(successor, shrank) : successor;
+}
+
+/**
+* Unlinks the smallest node below node into smallest, without freeing it.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::detachSmallest(uint32_t node, uint32_t& smallest, bool& shrank)
+{
+	if (nodes_[node].getLeft() == NIL){
+		smallest = node;
+		shrank = true;
+		return nodes_[node].getRight();
+	}
+	nodes_[node].setLeft(detachSmallest(nodes_[node].getLeft(), smallest, shrank));
+	return shrank ? leftShrank(node, shrank) : node;
+}
+
+/**
+* Accounts for node's left subtree having got shorter, rotating if that
+* left it unbalanced; shrank says whether node's subtree got shorter too.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::leftShrank(uint32_t node, bool& shrank)
+{
+	int balance = nodes_[node].getBalance() + 1;
+	if (balance == 2){
+		node = rebalance(node, balance);
+		shrank = (nodes_[node].getBalance() == 0);
+		return node;
+	}
+	nodes_[node].setBalance(balance);
+	shrank = (balance == 0);
+	return node;
+}
+
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::rightShrank(uint32_t node, bool& shrank)
+{
+	int balance = nodes_[node].getBalance() - 1;
+	if (balance == -2){
+		node = rebalance(node, balance);
+		shrank = (nodes_[node].getBalance() == 0);
+		return node;
+	}
+	nodes_[node].setBalance(balance);
+	shrank = (balance == 0);
+	return node;
+}
+
+/**
+* Rotates node's right child up and returns it. balance is node's balance
+* factor, passed in because a transient +-2 does not fit in the node.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::rotateLeft(uint32_t node, int balance)
+{
+	NodeType& x = nodes_[node];
+	uint32_t child = x.getRight();
+	NodeType& y = nodes_[child];
+	x.setRight(y.getLeft());
+	y.setLeft(node);
+
+	int xBalance = balance - 1 - std::max(y.getBalance(), 0);
+	int yBalance = y.getBalance() - 1 + std::min(xBalance, 0);
+	x.setBalance(xBalance);
+	y.setBalance(yBalance);
+	return child;
+}
+
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::rotateRight(uint32_t node, int balance)
+{
+	NodeType& x = nodes_[node];
+	uint32_t child = x.getLeft();
+	NodeType& y = nodes_[child];
+	x.setLeft(y.getRight());
+	y.setRight(node);
+
+	int xBalance = balance + 1 - std::min(y.getBalance(), 0);
+	int yBalance = y.getBalance() + 1 + std::max(xBalance, 0);
+	x.setBalance(xBalance);
+	y.setBalance(yBalance);
+	return child;
+}
+
+/**
+* Fixes a node whose balance has reached +-2 by a single or double
+* rotation and returns the subtree's new root. Halfway through a double
+* rotation the middle node is off by two as well, so the three final
+* balances are set directly from the middle node's original one.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::rebalance(uint32_t node, int balance)
+{
+	if (balance > 0){
+		uint32_t right = nodes_[node].getRight();
+		if (nodes_[right].getBalance() >= 0){
+			return rotateLeft(node, balance);
+		}
+		uint32_t middle = nodes_[right].getLeft();
+		int middleBalance = nodes_[middle].getBalance();
+		nodes_[node].setRight(rotateRight(right, nodes_[right].getBalance()));
+		rotateLeft(node, balance);
+		nodes_[node].setBalance(middleBalance > 0 ? -1 : 0);
+		nodes_[right].setBalance(middleBalance < 0 ? 1 : 0);
+		nodes_[middle].setBalance(0);
+		return middle;
+	}
+	uint32_t left = nodes_[node].getLeft();
+	if (nodes_[left].getBalance() <= 0){
+		return rotateRight(node, balance);
+	}
+	uint32_t middle = nodes_[left].getRight();
+	int middleBalance = nodes_[middle].getBalance();
+	nodes_[node].setLeft(rotateLeft(left, nodes_[left].getBalance()));
+	rotateRight(node, balance);
+	nodes_[node].setBalance(middleBalance < 0 ? 1 : 0);
+	nodes_[left].setBalance(middleBalance > 0 ? -1 : 0);
+	nodes_[middle].setBalance(0);
+	return middle;
+}
+
+/**
+* Places a node for item in a free slot, or at the end of the vector.
+*/
+template<class Key, class Value, class Compare>
+uint32_t CompactAVLTree<Key, Value, Compare>::newNode(const std::pair<const Key, Value>& item)
+{
+	uint32_t node;
+	if (freeList_ != NIL){
+		node = freeList_;
+		uint32_t next = nodes_[node].getLeft();
+		nodes_[node].setItem(item.first, item.second);
+		freeList_ = next;
+	}
+	else{
+		if (nodes_.size() >= NIL){
+			throw std::length_error("CompactAVLTree is full");
+		}
+		node = static_cast<uint32_t>(nodes_.size());
+		nodes_.push_back(NodeType(item.first, item.second));
+	}
+	++size_;
+	return node;
+}
+
+/**
+* Destroys node's item and chains its slot onto the free list.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::freeNode(uint32_t node)
+{
+	nodes_[node].releaseItem();
+	nodes_[node].setLeft(freeList_);
+	freeList_ = node;
+	--size_;
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::checkBalance(uint32_t node, int& height) const
+{
+	if (node == NIL){
+		height = 0;
+		return true;
+	}
+	int leftHeight, rightHeight;
+	if (!checkBalance(nodes_[node].getLeft(), leftHeight) || !checkBalance(nodes_[node].getRight(), rightHeight)){
+		return false;
+	}
+	height = std::max(leftHeight, rightHeight) + 1;
+	return rightHeight - leftHeight == nodes_[node].getBalance() &&
+		rightHeight - leftHeight <= 1 && leftHeight - rightHeight <= 1;
+}
+
+/*
+  ----------------------------------------------------
+  End implementations for the CompactAVLTree class.
+  ----------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,173 @@
+#include <iostream>
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include "concurrent_avlbst.h"
+
+using namespace std;
+
+/**
+* Stress test for ConcurrentAVLTree, meant to be built with
+* -fsanitize=thread (see the Makefile). Writers churn the tree while
+* readers check what they see. Run as ./concurrent-test [ops per thread].
+*
+* Every even key below 2 * STABLE_KEYS is inserted up front and never
+* removed, though writers keep re-inserting it (which swaps in a fresh
+* node). Writers insert and remove odd keys, each writer its own. Every
+* value is VALUE_FACTOR times its key, so a reader that sees a torn or
+* freed item sees a wrong value.
+*/
+
+typedef ConcurrentAVLTree<uint64_t, uint64_t> Tree;
+
+// Few keys keep the tree shallow, so rotations land on readers' paths often
+static const uint64_t STABLE_KEYS = 256;
+static const uint64_t VALUE_FACTOR = 7;
+static const size_t WRITERS = 3;
+static const size_t READERS = 3;
+
+static atomic<size_t> failures(0);
+
+void fail(const char* what, uint64_t key)
+{
+    if(failures.fetch_add(1) < 10) {
+        cout << "FAILED: " << what << " (key " << key << ")" << endl;
+    }
+}
+
+/**
+* Inserts and removes random odd keys owned by writer w (those with
+* key / 2 % WRITERS == w), and re-inserts stable keys. Records which of
+* its keys are present at the end in present.
+*/
+void writer(Tree& tree, size_t w, size_t ops, vector<char>& present)
+{
+    mt19937_64 rng(11 + w);
+    for(size_t i = 0; i < ops; ++i) {
+        uint64_t r = rng();
+        uint64_t slot = (r >> 8) % (STABLE_KEYS / WRITERS);
+        uint64_t key = 2 * (slot * WRITERS + w) + 1;
+        switch(r % 4) {
+        case 0:
+        case 1:
+            tree.insert(make_pair(key, key * VALUE_FACTOR));
+            present[slot] = 1;
+            break;
+        case 2:
+            tree.remove(key);
+            present[slot] = 0;
+            break;
+        default: {
+            uint64_t stable = 2 * ((r >> 8) % STABLE_KEYS);
+            tree.insert(make_pair(stable, stable * VALUE_FACTOR));
+        }
+        }
+    }
+}
+
+/**
+* Finds stable and churning keys, and scans ranges, checking each result.
+*/
+void reader(const Tree& tree, size_t r, size_t ops)
+{
+    mt19937_64 rng(101 + r);
+    for(size_t i = 0; i < ops; ++i) {
+        uint64_t draw = rng();
+        uint64_t key = (draw >> 8) % (2 * STABLE_KEYS);
+        uint64_t value;
+        bool found = tree.find(key, value);
+        if(key % 2 == 0 && !found) {
+            fail("stable key not found", key);
+        }
+        if(found && value != key * VALUE_FACTOR) {
+            fail("wrong value", key);
+        }
+
+        if(draw % 16 == 0) {
+            // Every stable key in [lo, hi] must appear, in order
+            uint64_t lo = key;
+            uint64_t hi = lo + 64;
+            uint64_t next = lo;
+            bool first = true;
+            uint64_t prev = 0;
+            tree.rangeScan(lo, hi, [&](const pair<const uint64_t, uint64_t>& item) {
+                if(item.first < lo || item.first > hi) {
+                    fail("range scan item out of range", item.first);
+                }
+                if(!first && item.first <= prev) {
+                    fail("range scan out of order", item.first);
+                }
+                if(item.second != item.first * VALUE_FACTOR) {
+                    fail("range scan wrong value", item.first);
+                }
+                for(; next < item.first && next <= hi; ++next) {
+                    if(next % 2 == 0 && next < 2 * STABLE_KEYS) {
+                        fail("range scan skipped a stable key", next);
+                    }
+                }
+                next = item.first + 1;
+                first = false;
+                prev = item.first;
+            });
+            for(; next <= hi; ++next) {
+                if(next % 2 == 0 && next < 2 * STABLE_KEYS) {
+                    fail("range scan skipped a stable key", next);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t ops = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+
+    Tree tree;
+    for(uint64_t key = 0; key < 2 * STABLE_KEYS; key += 2) {
+        tree.insert(make_pair(key, key * VALUE_FACTOR));
+    }
+
+    vector<vector<char> > present(WRITERS, vector<char>(STABLE_KEYS / WRITERS, 0));
+    vector<thread> threads;
+    for(size_t w = 0; w < WRITERS; ++w) {
+        threads.push_back(thread(writer, ref(tree), w, ops, ref(present[w])));
+    }
+    for(size_t r = 0; r < READERS; ++r) {
+        threads.push_back(thread(reader, cref(tree), r, ops));
+    }
+    for(size_t t = 0; t < threads.size(); ++t) {
+        threads[t].join();
+    }
+
+    // Once quiet, the tree must hold exactly the stable keys plus the odd
+    // keys each writer left behind
+    size_t expected = STABLE_KEYS;
+    for(size_t w = 0; w < WRITERS; ++w) {
+        for(uint64_t slot = 0; slot < present[w].size(); ++slot) {
+            uint64_t key = 2 * (slot * WRITERS + w) + 1;
+            if(present[w][slot]) {
+                ++expected;
+            }
+            if(tree.contains(key) != bool(present[w][slot])) {
+                fail("final contents differ from the writers' own record", key);
+            }
+        }
+    }
+    if(tree.size() != expected) {
+        fail("final size", tree.size());
+    }
+    size_t walked = 0;
+    tree.forEach([&walked](const pair<const uint64_t, uint64_t>&) { ++walked; });
+    if(walked != expected) {
+        fail("forEach count", walked);
+    }
+    if(!tree.isBalanced()) {
+        fail("tree is not balanced", 0);
+    }
+
+    cout << (failures == 0 ? "concurrent test: ok" : "concurrent test: FAILED") << endl;
+    return failures == 0 ? 0 : 1;
+}
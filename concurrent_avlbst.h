@@ -0,0 +1,897 @@
+#ifndef CONCURRENT_AVLBST_H
+#define CONCURRENT_AVLBST_H
+
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <functional>
+#include <algorithm>
+#include <vector>
+#include <new>
+#include <cstdint>
+#include <cstddef>
+#include "node_pool.h"
+#include "epoch_domain.h"
+
+/**
+* A node of a ConcurrentAVLTree. The item never changes once the node is
+* reachable, and child links are atomic so readers can follow them while
+* the writer relinks. The version is odd while the writer is shrinking
+* the range of keys the node's subtree may hold (rotating it down, or
+* moving a key out from under it); readers re-check it after every step.
+* Parent and balance are only touched by the writer.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLNode
+{
+public:
+    template<typename... Args>
+    ConcurrentAVLNode(ConcurrentAVLNode<Key, Value>* parent, Args&&... args);
+
+    const std::pair<const Key, Value>& getItem() const;
+    const Key& getKey() const;
+    const Value& getValue() const;
+
+    ConcurrentAVLNode<Key, Value>* getLeft() const;
+    ConcurrentAVLNode<Key, Value>* getRight() const;
+    void setLeft(ConcurrentAVLNode<Key, Value>* left);
+    void setRight(ConcurrentAVLNode<Key, Value>* right);
+
+    // Optimistic validation, see the class comment
+    uint64_t getVersion() const;
+    bool validate(uint64_t version) const;
+    void beginChange();
+    void endChange();
+
+    // Writer-only state. Once a node is retired, its parent pointer links
+    // it into the retired list instead.
+    ConcurrentAVLNode<Key, Value>* getParent() const;
+    void setParent(ConcurrentAVLNode<Key, Value>* parent);
+    int8_t getBalance() const;
+    void setBalance(int8_t balance);
+    void updateBalance(int8_t diff);
+
+protected:
+    std::pair<const Key, Value> item_;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> left_;
+    std::atomic<ConcurrentAVLNode<Key, Value>*> right_;
+    std::atomic<uint64_t> version_;
+    ConcurrentAVLNode<Key, Value>* parent_;
+    int8_t balance_;
+};
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the ConcurrentAVLNode class.
+  -----------------------------------------------------------
+*/
+
+/**
+* Builds the item in place from args; the node starts as an unlinked leaf.
+*/
+template<class Key, class Value>
+template<typename... Args>
+ConcurrentAVLNode<Key, Value>::ConcurrentAVLNode(ConcurrentAVLNode<Key, Value>* parent, Args&&... args) :
+    item_(std::forward<Args>(args)...),
+    left_(nullptr),
+    right_(nullptr),
+    version_(0),
+    parent_(parent),
+    balance_(0)
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& ConcurrentAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& ConcurrentAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+const Value& ConcurrentAVLNode<Key, Value>::getValue() const
+{
+    return item_.second;
+}
+
+/**
+* Child getters acquire, so whatever the writer did to a child before
+* publishing it is visible to the reader that finds it.
+*/
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getLeft() const
+{
+    return left_.load(std::memory_order_acquire);
+}
+
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getRight() const
+{
+    return right_.load(std::memory_order_acquire);
+}
+
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::setLeft(ConcurrentAVLNode<Key, Value>* left)
+{
+    left_.store(left, std::memory_order_release);
+}
+
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::setRight(ConcurrentAVLNode<Key, Value>* right)
+{
+    right_.store(right, std::memory_order_release);
+}
+
+/**
+* Reads the version before following a child link.
+*/
+template<class Key, class Value>
+uint64_t ConcurrentAVLNode<Key, Value>::getVersion() const
+{
+    return version_.load(std::memory_order_acquire);
+}
+
+/**
+* True if the node has not started or finished a change since getVersion()
+* returned version, i.e. the links read in between are trustworthy.
+*/
+template<class Key, class Value>
+bool ConcurrentAVLNode<Key, Value>::validate(uint64_t version) const
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == version;
+}
+
+/**
+* Called by the writer before relinking in a way that shrinks this
+* subtree's key range. Makes the version odd.
+*/
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::beginChange()
+{
+    version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::endChange()
+{
+    version_.store(version_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+template<class Key, class Value>
+ConcurrentAVLNode<Key, Value>* ConcurrentAVLNode<Key, Value>::getParent() const
+{
+    return parent_;
+}
+
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::setParent(ConcurrentAVLNode<Key, Value>* parent)
+{
+    parent_ = parent;
+}
+
+template<class Key, class Value>
+int8_t ConcurrentAVLNode<Key, Value>::getBalance() const
+{
+    return balance_;
+}
+
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+template<class Key, class Value>
+void ConcurrentAVLNode<Key, Value>::updateBalance(int8_t diff)
+{
+    balance_ += diff;
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the ConcurrentAVLNode class.
+  ---------------------------------------------------------
+*/
+
+// Retired nodes are handed back in batches of at least this many.
+static const size_t CONCURRENT_AVL_RECLAIM_BATCH = 64;
+
+/**
+* An AVL tree that any number of threads may read while others write.
+*
+* Lookups, iteration and range scans take no lock: they descend with
+* hand-over-hand version validation and start over from the root if a
+* node on their path was rotated or otherwise shrunk under them.
+* Writers take one lock between them and rebalance in place, marking the
+* nodes they shrink. Nodes unlinked by remove() or replaced by insert()
+* are retired to an EpochDomain and only freed once no reader can still
+* hold them.
+*
+* Readers get copies or callbacks, never iterators: a pointer into the
+* tree is only safe inside the call that found it.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class ConcurrentAVLTree
+{
+public:
+    ConcurrentAVLTree();
+    explicit ConcurrentAVLTree(const Compare& comp);
+    ~ConcurrentAVLTree();
+
+    // Writers; these serialize with each other but not with readers
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    // Readers, safe to call concurrently with everything above
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    template<typename Fn>
+    void forEach(Fn fn) const;
+    template<typename Fn>
+    void rangeScan(const Key& lo, const Key& hi, Fn fn) const;
+    size_t size() const;
+    bool empty() const;
+
+    bool isBalanced() const;
+
+protected:
+    typedef ConcurrentAVLNode<Key, Value> NodeType;
+
+    enum SearchMode { SEARCH_EXACT, SEARCH_CEILING, SEARCH_HIGHER, SEARCH_FIRST };
+    const NodeType* search(const Key* key, SearchMode mode) const;
+
+    NodeType* constructNode(NodeType* parent, const std::pair<const Key, Value>& item);
+    void destroyNode(NodeType* node);
+    void replaceChild(NodeType* parent, NodeType* oldChild, NodeType* newChild);
+    NodeType* rotateLeft(NodeType* node);
+    NodeType* rotateRight(NodeType* node);
+    NodeType* rebalance(NodeType* node);
+    void insertFix(NodeType* node);
+    void removeFix(NodeType* node, bool leftShrank);
+    void retire(NodeType* node);
+    void reclaim();
+    size_t freeRetired(NodeType*& list);
+    bool checkBalance(NodeType* node, int& height) const;
+    static void collectNodes(NodeType* node, std::vector<NodeType*>& nodes);
+
+private:
+    // Not copyable
+    ConcurrentAVLTree(const ConcurrentAVLTree& other);
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree& other);
+
+protected:
+    std::atomic<NodeType*> root_;
+    std::atomic<size_t> size_;
+    mutable EpochDomain epochs_;
+    mutable std::mutex writeLock_;
+    NodePool pool_;
+    Compare comp_;
+    NodeType* retired_[2];      // by parity of the epoch they were retired in
+    size_t retiredCount_;
+};
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the ConcurrentAVLTree class.
+  ----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::ConcurrentAVLTree() :
+    root_(nullptr),
+    size_(0),
+    pool_(sizeof(NodeType), alignof(NodeType)),
+    comp_(),
+    retiredCount_(0)
+{
+    retired_[0] = retired_[1] = nullptr;
+}
+
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::ConcurrentAVLTree(const Compare& comp) :
+    root_(nullptr),
+    size_(0),
+    pool_(sizeof(NodeType), alignof(NodeType)),
+    comp_(comp),
+    retiredCount_(0)
+{
+    retired_[0] = retired_[1] = nullptr;
+}
+
+/**
+* No thread may be using the tree any more, so everything is freed at once.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLTree<Key, Value, Compare>::~ConcurrentAVLTree()
+{
+	std::vector<NodeType*> nodes;
+	collectNodes(root_.load(std::memory_order_relaxed), nodes);
+	for (size_t i = 0; i < nodes.size(); ++i){
+		destroyNode(nodes[i]);
+	}
+	freeRetired(retired_[0]);
+	freeRetired(retired_[1]);
+	pool_.release();
+}
+
+/**
+* Inserts the item, or replaces the value if the key is present. A
+* replaced value lives in a fresh node that takes the old one's place, so
+* readers of the old node keep seeing a consistent item.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	std::lock_guard<std::mutex> lock(writeLock_);
+
+	NodeType* parent = nullptr;
+	NodeType* curr = root_.load(std::memory_order_relaxed);
+	bool goLeft = false;
+	while (curr != nullptr){
+		if (comp_(keyValuePair.first, curr->getKey())){
+			goLeft = true;
+		}
+		else if (comp_(curr->getKey(), keyValuePair.first)){
+			goLeft = false;
+		}
+		else{
+			break;
+		}
+		parent = curr;
+		curr = goLeft ? curr->getLeft() : curr->getRight();
+	}
+
+	if (curr != nullptr){
+		NodeType* fresh = constructNode(curr->getParent(), keyValuePair);
+		fresh->setLeft(curr->getLeft());
+		fresh->setRight(curr->getRight());
+		fresh->setBalance(curr->getBalance());
+		if (curr->getLeft() != nullptr){
+			curr->getLeft()->setParent(fresh);
+		}
+		if (curr->getRight() != nullptr){
+			curr->getRight()->setParent(fresh);
+		}
+		replaceChild(curr->getParent(), curr, fresh);
+		retire(curr);
+		reclaim();
+		return;
+	}
+
+	NodeType* node = constructNode(parent, keyValuePair);
+	if (parent == nullptr){
+		root_.store(node, std::memory_order_release);
+	}
+	else if (goLeft){
+		parent->setLeft(node);
+	}
+	else{
+		parent->setRight(node);
+	}
+	size_.fetch_add(1, std::memory_order_relaxed);
+	insertFix(node);
+}
+
+/**
+* Removes the key if present. A node with two children is replaced by its
+* predecessor; every node between them loses that key from its range, so
+* they are all marked while the predecessor moves up.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+	std::lock_guard<std::mutex> lock(writeLock_);
+
+	NodeType* curr = root_.load(std::memory_order_relaxed);
+	while (curr != nullptr){
+		if (comp_(key, curr->getKey())){
+			curr = curr->getLeft();
+		}
+		else if (comp_(curr->getKey(), key)){
+			curr = curr->getRight();
+		}
+		else{
+			break;
+		}
+	}
+	if (curr == nullptr){
+		return;
+	}
+	size_.fetch_sub(1, std::memory_order_relaxed);
+
+	NodeType* parent = curr->getParent();
+	NodeType* left = curr->getLeft();
+	NodeType* right = curr->getRight();
+	if (left == nullptr || right == nullptr){
+		NodeType* child = (left != nullptr) ? left : right;
+		bool leftSide = (parent != nullptr && parent->getLeft() == curr);
+		replaceChild(parent, curr, child);
+		if (child != nullptr){
+			child->setParent(parent);
+		}
+		retire(curr);
+		if (parent != nullptr){
+			removeFix(parent, leftSide);
+		}
+		reclaim();
+		return;
+	}
+
+	NodeType* pred = left;
+	while (pred->getRight() != nullptr){
+		pred = pred->getRight();
+	}
+
+	if (pred == left){
+		pred->setRight(right);
+		right->setParent(pred);
+		pred->setBalance(curr->getBalance());
+		replaceChild(parent, curr, pred);
+		pred->setParent(parent);
+		retire(curr);
+		removeFix(pred, true);
+		reclaim();
+		return;
+	}
+
+	NodeType* predParent = pred->getParent();
+	for (NodeType* n = left; n != pred; n = n->getRight()){
+		n->beginChange();
+	}
+	NodeType* predChild = pred->getLeft();
+	predParent->setRight(predChild);
+	if (predChild != nullptr){
+		predChild->setParent(predParent);
+	}
+	pred->setLeft(left);
+	left->setParent(pred);
+	pred->setRight(right);
+	right->setParent(pred);
+	pred->setBalance(curr->getBalance());
+	replaceChild(parent, curr, pred);
+	pred->setParent(parent);
+	for (NodeType* n = left; ; n = n->getRight()){
+		n->endChange();
+		if (n == predParent){
+			break;
+		}
+	}
+	retire(curr);
+	removeFix(predParent, false);
+	reclaim();
+}
+
+/**
+* Unlinks every node at once. Readers already inside the tree finish on
+* the old nodes, which are retired rather than freed.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::clear()
+{
+	std::lock_guard<std::mutex> lock(writeLock_);
+	std::vector<NodeType*> nodes;
+	collectNodes(root_.load(std::memory_order_relaxed), nodes);
+	root_.store(nullptr, std::memory_order_release);
+	size_.store(0, std::memory_order_relaxed);
+	for (size_t i = 0; i < nodes.size(); ++i){
+		retire(nodes[i]);
+	}
+	reclaim();
+}
+
+/**
+* Copies the value stored under key into value and returns true, or
+* returns false if the key is absent.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+	EpochDomain::Guard guard(epochs_);
+	const NodeType* node = search(&key, SEARCH_EXACT);
+	if (node == nullptr){
+		return false;
+	}
+	value = node->getValue();
+	return true;
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::contains(const Key& key) const
+{
+	EpochDomain::Guard guard(epochs_);
+	return search(&key, SEARCH_EXACT) != nullptr;
+}
+
+/**
+* Calls fn on every item in key order. Each step is a fresh search for the
+* next larger key, so concurrent writes never cause an item to be seen
+* twice or out of order; items present throughout the walk are all seen.
+*/
+template<class Key, class Value, class Compare>
+template<typename Fn>
+void ConcurrentAVLTree<Key, Value, Compare>::forEach(Fn fn) const
+{
+	EpochDomain::Guard guard(epochs_);
+	const NodeType* node = search(nullptr, SEARCH_FIRST);
+	while (node != nullptr){
+		fn(node->getItem());
+		node = search(&node->getKey(), SEARCH_HIGHER);
+	}
+}
+
+/**
+* Calls fn on every item with lo <= key <= hi, in key order, with the
+* same guarantees as forEach().
+*/
+template<class Key, class Value, class Compare>
+template<typename Fn>
+void ConcurrentAVLTree<Key, Value, Compare>::rangeScan(const Key& lo, const Key& hi, Fn fn) const
+{
+	EpochDomain::Guard guard(epochs_);
+	const NodeType* node = search(&lo, SEARCH_CEILING);
+	while (node != nullptr && !comp_(hi, node->getKey())){
+		fn(node->getItem());
+		node = search(&node->getKey(), SEARCH_HIGHER);
+	}
+}
+
+template<class Key, class Value, class Compare>
+size_t ConcurrentAVLTree<Key, Value, Compare>::size() const
+{
+	return size_.load(std::memory_order_relaxed);
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::empty() const
+{
+	return root_.load(std::memory_order_acquire) == nullptr;
+}
+
+/**
+* Checks heights and stored balance factors; takes the writer lock.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::isBalanced() const
+{
+	std::lock_guard<std::mutex> lock(writeLock_);
+	int height;
+	return checkBalance(root_.load(std::memory_order_relaxed), height);
+}
+
+/**
+* Lock-free descent; must be called inside an epoch guard. Returns the
+* node with key (SEARCH_EXACT), the smallest key not less than key
+* (SEARCH_CEILING) or greater than key (SEARCH_HIGHER), or the smallest
+* key of all (SEARCH_FIRST, key unused), or NULL if there is none.
+*
+* Before stepping to a child, the parent's version is re-checked: if it is
+* unchanged, the child was linked there while the parent's key range still
+* covered key, so the child's range did too. A changed or odd version
+* means a rotation got in the way, and the search starts over, as does a
+* link that no longer points at the child once its version is read.
+* Retired nodes stay odd, so a search never leaves one by a stale link.
+*/
+template<class Key, class Value, class Compare>
+const typename ConcurrentAVLTree<Key, Value, Compare>::NodeType*
+ConcurrentAVLTree<Key, Value, Compare>::search(const Key* key, SearchMode mode) const
+{
+	for (;;){
+		NodeType* curr = root_.load(std::memory_order_acquire);
+		if (curr == nullptr){
+			return nullptr;
+		}
+		uint64_t version = curr->getVersion();
+		if ((version & 1) != 0 || root_.load(std::memory_order_acquire) != curr){
+			continue;
+		}
+
+		const NodeType* candidate = nullptr;
+		for (;;){
+			bool goLeft;
+			if (mode == SEARCH_FIRST || comp_(*key, curr->getKey())){
+				goLeft = true;
+			}
+			else if (mode != SEARCH_HIGHER && !comp_(curr->getKey(), *key)){
+				return curr;
+			}
+			else{
+				goLeft = false;
+			}
+			if (goLeft){
+				candidate = curr;
+			}
+
+			NodeType* child = goLeft ? curr->getLeft() : curr->getRight();
+			if (child == nullptr){
+				if (curr->validate(version)){
+					return (mode == SEARCH_EXACT) ? nullptr : candidate;
+				}
+				break;
+			}
+			// The link is read again once the child's version is in hand: a
+			// child rotated away in between would otherwise go unnoticed.
+			uint64_t childVersion = child->getVersion();
+			if ((goLeft ? curr->getLeft() : curr->getRight()) != child
+				|| !curr->validate(version) || (childVersion & 1) != 0){
+				break;
+			}
+			curr = child;
+			version = childVersion;
+		}
+	}
+}
+
+/**
+* Builds a node in a block from the pool; only the writer allocates.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::NodeType*
+ConcurrentAVLTree<Key, Value, Compare>::constructNode(NodeType* parent, const std::pair<const Key, Value>& item)
+{
+	void* block = pool_.allocate();
+	try {
+		return new (block) NodeType(parent, item);
+	}
+	catch (...) {
+		pool_.deallocate(block);
+		throw;
+	}
+}
+
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::destroyNode(NodeType* node)
+{
+	node->~NodeType();
+	pool_.deallocate(node);
+}
+
+/**
+* Points whichever link led to oldChild (or the root) at newChild.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::replaceChild(NodeType* parent, NodeType* oldChild, NodeType* newChild)
+{
+	if (parent == nullptr){
+		root_.store(newChild, std::memory_order_release);
+	}
+	else if (parent->getLeft() == oldChild){
+		parent->setLeft(newChild);
+	}
+	else{
+		parent->setRight(newChild);
+	}
+}
+
+/**
+* Rotates node's right child up and returns it. node moves down, so its
+* range shrinks and it is marked for the duration. The inner subtree is
+* moved before node is hung under the child, so readers never see a cycle.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::NodeType*
+ConcurrentAVLTree<Key, Value, Compare>::rotateLeft(NodeType* node)
+{
+	NodeType* parent = node->getParent();
+	NodeType* child = node->getRight();
+	NodeType* inner = child->getLeft();
+
+	node->beginChange();
+	node->setRight(inner);
+	if (inner != nullptr){
+		inner->setParent(node);
+	}
+	child->setLeft(node);
+	node->setParent(child);
+	replaceChild(parent, node, child);
+	child->setParent(parent);
+	node->endChange();
+
+	int nodeBalance = node->getBalance() - 1 - std::max<int>(child->getBalance(), 0);
+	int childBalance = child->getBalance() - 1 + std::min(nodeBalance, 0);
+	node->setBalance(nodeBalance);
+	child->setBalance(childBalance);
+	return child;
+}
+
+/**
+* Mirror image of rotateLeft().
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::NodeType*
+ConcurrentAVLTree<Key, Value, Compare>::rotateRight(NodeType* node)
+{
+	NodeType* parent = node->getParent();
+	NodeType* child = node->getLeft();
+	NodeType* inner = child->getRight();
+
+	node->beginChange();
+	node->setLeft(inner);
+	if (inner != nullptr){
+		inner->setParent(node);
+	}
+	child->setRight(node);
+	node->setParent(child);
+	replaceChild(parent, node, child);
+	child->setParent(parent);
+	node->endChange();
+
+	int nodeBalance = node->getBalance() + 1 - std::min<int>(child->getBalance(), 0);
+	int childBalance = child->getBalance() + 1 + std::max(nodeBalance, 0);
+	node->setBalance(nodeBalance);
+	child->setBalance(childBalance);
+	return child;
+}
+
+/**
+* Fixes a node with balance +-2 by a single or double rotation and returns
+* the subtree's new root.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLTree<Key, Value, Compare>::NodeType*
+ConcurrentAVLTree<Key, Value, Compare>::rebalance(NodeType* node)
+{
+	if (node->getBalance() > 0){
+		if (node->getRight()->getBalance() < 0){
+			rotateRight(node->getRight());
+		}
+		return rotateLeft(node);
+	}
+	if (node->getLeft()->getBalance() > 0){
+		rotateLeft(node->getLeft());
+	}
+	return rotateRight(node);
+}
+
+/**
+* Walks up from a new leaf until a subtree's height stops changing or one
+* rotation restores it.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::insertFix(NodeType* node)
+{
+	NodeType* curr = node;
+	NodeType* parent = curr->getParent();
+	while (parent != nullptr){
+		parent->updateBalance((parent->getLeft() == curr) ? -1 : 1);
+		if (parent->getBalance() == 0){
+			return;
+		}
+		if (parent->getBalance() == 2 || parent->getBalance() == -2){
+			rebalance(parent);
+			return;
+		}
+		curr = parent;
+		parent = parent->getParent();
+	}
+}
+
+/**
+* Walks up from node, one of whose subtrees just got shorter, until the
+* height loss is absorbed.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::removeFix(NodeType* node, bool leftShrank)
+{
+	NodeType* curr = node;
+	for (;;){
+		curr->updateBalance(leftShrank ? 1 : -1);
+		if (curr->getBalance() == 1 || curr->getBalance() == -1){
+			return;
+		}
+		if (curr->getBalance() == 2 || curr->getBalance() == -2){
+			curr = rebalance(curr);
+			if (curr->getBalance() != 0){
+				return;
+			}
+		}
+		NodeType* parent = curr->getParent();
+		if (parent == nullptr){
+			return;
+		}
+		leftShrank = (parent->getLeft() == curr);
+		curr = parent;
+	}
+}
+
+/**
+* Queues an unlinked node to be freed once no reader can reach it. Its
+* version is left odd for good: the subtrees under its stale child links
+* go on being rebalanced without it, so a reader standing on it must
+* start over rather than follow them.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::retire(NodeType* node)
+{
+	node->beginChange();
+	unsigned parity = epochs_.epoch() & 1;
+	node->setParent(retired_[parity]);
+	retired_[parity] = node;
+	++retiredCount_;
+}
+
+/**
+* Once enough nodes are waiting: if every reader from the previous epoch
+* has left, frees that epoch's nodes and starts a new epoch, whose
+* retirements reuse the emptied list.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::reclaim()
+{
+	if (retiredCount_ < CONCURRENT_AVL_RECLAIM_BATCH){
+		return;
+	}
+	unsigned e = epochs_.epoch();
+	if (epochs_.drained(e - 1)){
+		retiredCount_ -= freeRetired(retired_[(e - 1) & 1]);
+		epochs_.advance();
+	}
+}
+
+/**
+* Frees a retired list and returns how many nodes it held.
+*/
+template<class Key, class Value, class Compare>
+size_t ConcurrentAVLTree<Key, Value, Compare>::freeRetired(NodeType*& list)
+{
+	size_t count = 0;
+	while (list != nullptr){
+		NodeType* next = list->getParent();
+		destroyNode(list);
+		list = next;
+		++count;
+	}
+	return count;
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLTree<Key, Value, Compare>::checkBalance(NodeType* node, int& height) const
+{
+	if (node == nullptr){
+		height = 0;
+		return true;
+	}
+	int leftHeight, rightHeight;
+	if (!checkBalance(node->getLeft(), leftHeight) || !checkBalance(node->getRight(), rightHeight)){
+		return false;
+	}
+	height = std::max(leftHeight, rightHeight) + 1;
+	return rightHeight - leftHeight == node->getBalance() &&
+		rightHeight - leftHeight <= 1 && leftHeight - rightHeight <= 1;
+}
+
+/**
+* Appends every node of the subtree at node to nodes.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLTree<Key, Value, Compare>::collectNodes(NodeType* node, std::vector<NodeType*>& nodes)
+{
+	size_t next = nodes.size();
+	if (node != nullptr){
+		nodes.push_back(node);
+	}
+	for (; next < nodes.size(); ++next){
+		if (nodes[next]->getLeft() != nullptr){
+			nodes.push_back(nodes[next]->getLeft());
+		}
+		if (nodes[next]->getRight() != nullptr){
+			nodes.push_back(nodes[next]->getRight());
+		}
+	}
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the ConcurrentAVLTree class.
+  --------------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,184 @@
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <string>
+#include <random>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include "durable_avlbst.h"
+
+using namespace std;
+
+typedef DurableAVLTree<uint32_t, uint64_t> Tree;
+
+static const string snapshotPath = "durable-test.snapshot";
+static const string logPath = "durable-test.wal";
+
+static int failures = 0;
+
+/**
+* Reports whether tree holds exactly the items of expected.
+*/
+void check(const char* msg, const Tree& tree, const map<uint32_t, uint64_t>& expected)
+{
+    bool ok = tree.size() == expected.size();
+    for(map<uint32_t, uint64_t>::const_iterator it = expected.begin(); ok && it != expected.end(); ++it) {
+        uint64_t value;
+        ok = tree.find(it->first, value) && value == it->second;
+    }
+    cout << msg << ": " << (ok ? "ok" : "FAILED") << endl;
+    if(!ok) {
+        ++failures;
+    }
+}
+
+/**
+* Applies count random inserts and removes of keys below 1000 to both tree
+* and expected.
+*/
+void randomWrites(Tree& tree, map<uint32_t, uint64_t>& expected, mt19937& rng, size_t count)
+{
+    for(size_t i = 0; i < count; ++i) {
+        uint32_t key = rng() % 1000;
+        if(rng() % 4 == 0) {
+            tree.remove(key);
+            expected.erase(key);
+        }
+        else {
+            uint64_t value = rng();
+            tree.insert(make_pair(key, value));
+            expected[key] = value;
+        }
+    }
+}
+
+void copyFile(const string& from, const string& to)
+{
+    ifstream in(from.c_str(), ios::binary);
+    ofstream out(to.c_str(), ios::binary | ios::trunc);
+    out << in.rdbuf();
+}
+
+void removeFiles()
+{
+    remove(snapshotPath.c_str());
+    remove((snapshotPath + ".tmp").c_str());
+    remove(logPath.c_str());
+    remove((logPath + ".copy").c_str());
+}
+
+int main()
+{
+    removeFiles();
+    map<uint32_t, uint64_t> expected;
+    mt19937 rng(5);
+
+    // Replay with no snapshot: everything comes from the log
+    {
+        Tree tree(snapshotPath, logPath);
+        randomWrites(tree, expected, rng, 3000);
+    }
+    {
+        Tree tree(snapshotPath, logPath);
+        check("replay of the log alone", tree, expected);
+    }
+
+    // A record cut short by a crash is dropped, and writes made after
+    // reopening are not lost behind it
+    {
+        ofstream log(logPath.c_str(), ios::binary | ios::app);
+        const char torn[] = { 0x10, 0, 0, 0, 'a', 'b', 'c' };
+        log.write(torn, sizeof(torn));
+    }
+    {
+        Tree tree(snapshotPath, logPath);
+        check("replay past a torn tail", tree, expected);
+        randomWrites(tree, expected, rng, 200);
+    }
+    {
+        Tree tree(snapshotPath, logPath);
+        check("writes after a torn tail", tree, expected);
+    }
+
+    // A crash can leave the file extended with zeros past the last record;
+    // they must not read as empty records
+    {
+        ofstream log(logPath.c_str(), ios::binary | ios::app);
+        const char zeros[64] = { 0 };
+        log.write(zeros, sizeof(zeros));
+    }
+    {
+        Tree tree(snapshotPath, logPath);
+        check("replay past a zero-filled tail", tree, expected);
+        randomWrites(tree, expected, rng, 200);
+    }
+    {
+        Tree tree(snapshotPath, logPath);
+        check("writes after a zero-filled tail", tree, expected);
+    }
+
+    // Checkpoint, then more writes: the snapshot plus the new log
+    {
+        Tree tree(snapshotPath, logPath);
+        tree.checkpoint();
+        check("checkpoint", tree, expected);
+        randomWrites(tree, expected, rng, 500);
+    }
+    {
+        Tree tree(snapshotPath, logPath);
+        check("replay on top of a checkpoint", tree, expected);
+    }
+
+    // A crash after the snapshot is saved but before the log is cut
+    // replays the old log over the new snapshot
+    {
+        Tree tree(snapshotPath, logPath);
+        randomWrites(tree, expected, rng, 500);
+        copyFile(logPath, logPath + ".copy");
+        tree.checkpoint();
+    }
+    copyFile(logPath + ".copy", logPath);
+    {
+        Tree tree(snapshotPath, logPath);
+        check("crash between snapshot and log truncation", tree, expected);
+    }
+
+    // Concurrent writers on disjoint keys all survive a restart
+    {
+        Tree tree(snapshotPath, logPath);
+        vector<thread> writers;
+        for(uint32_t t = 0; t < 8; ++t) {
+            writers.push_back(thread([&tree, t]() {
+                for(uint32_t i = 0; i < 250; ++i) {
+                    uint32_t key = 10000 + t * 1000 + i;
+                    tree.insert(make_pair(key, uint64_t(key) * 3));
+                    if(i % 5 == 0) {
+                        tree.remove(key);
+                    }
+                }
+            }));
+        }
+        for(size_t t = 0; t < writers.size(); ++t) {
+            writers[t].join();
+        }
+        for(uint32_t t = 0; t < 8; ++t) {
+            for(uint32_t i = 0; i < 250; ++i) {
+                uint32_t key = 10000 + t * 1000 + i;
+                if(i % 5 != 0) {
+                    expected[key] = uint64_t(key) * 3;
+                }
+            }
+        }
+        check("concurrent writers", tree, expected);
+        cout << "  records per fsync: " << double(tree.loggedRecords()) / tree.loggedSyncs() << endl;
+    }
+    {
+        Tree tree(snapshotPath, logPath);
+        check("replay of concurrent writers", tree, expected);
+    }
+
+    removeFiles();
+    return failures == 0 ? 0 : 1;
+}
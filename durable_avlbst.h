@@ -0,0 +1,249 @@
+#ifndef DURABLE_AVLBST_H
+#define DURABLE_AVLBST_H
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include "avlbst.h"
+#include "write_ahead_log.h"
+
+/**
+* An AVLTree whose writes survive a crash. Each insert() or remove() is
+* applied to the tree, logged to a WriteAheadLog, and returns once that
+* record is on disk; writes from concurrent threads share one fsync (see
+* WriteAheadLog). checkpoint() saves a snapshot and empties the log, and
+* the constructor rebuilds the tree from the last snapshot plus whatever
+* was logged after it.
+*
+* All calls are thread-safe. A write is visible to readers as soon as it
+* is applied, a moment before it is durable; if the log cannot be written
+* the write throws std::runtime_error, stays applied in memory, and is
+* lost on restart.
+*
+* Keys and values are logged as raw bytes, so both must be trivially
+* copyable, as for AVLTree::save().
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class DurableAVLTree
+{
+public:
+    DurableAVLTree(const std::string& snapshotPath, const std::string& logPath);
+    DurableAVLTree(const std::string& snapshotPath, const std::string& logPath, const Compare& comp);
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void checkpoint();
+
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    size_t size() const;
+    bool empty() const;
+
+    // Log statistics since the tree was opened
+    uint64_t loggedRecords() const;
+    uint64_t loggedSyncs() const;
+
+protected:
+    // The first byte of each log record
+    enum LogOp { LOG_INSERT = 1, LOG_REMOVE = 2 };
+
+    void recover();
+    void applyRecord(const char* record, size_t size);
+
+private:
+    // Not copyable
+    DurableAVLTree(const DurableAVLTree& other);
+    DurableAVLTree& operator=(const DurableAVLTree& other);
+
+protected:
+    AVLTree<Key, Value, Compare> tree_;
+    WriteAheadLog log_;
+    mutable std::mutex treeLock_;   // orders log records the same as the writes they describe
+    std::string snapshotPath_;
+    std::string logPath_;
+};
+
+/*
+  -------------------------------------------------------
+  Begin implementations for the DurableAVLTree class.
+  -------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+DurableAVLTree<Key, Value, Compare>::DurableAVLTree(const std::string& snapshotPath, const std::string& logPath) :
+    tree_(),
+    snapshotPath_(snapshotPath),
+    logPath_(logPath)
+{
+    recover();
+}
+
+template<class Key, class Value, class Compare>
+DurableAVLTree<Key, Value, Compare>::DurableAVLTree(const std::string& snapshotPath, const std::string& logPath, const Compare& comp) :
+    tree_(comp),
+    snapshotPath_(snapshotPath),
+    logPath_(logPath)
+{
+    recover();
+}
+
+/**
+* Loads the snapshot, if there is one, replays the log on top of it and
+* opens the log for new writes. A record torn by a crash ends the replay
+* (see WriteAheadLog::replay()); its write never returned, so it is
+* simply not there.
+*/
+template<class Key, class Value, class Compare>
+void DurableAVLTree<Key, Value, Compare>::recover()
+{
+	static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+		"DurableAVLTree logs keys and values as raw bytes");
+	if (::access(snapshotPath_.c_str(), F_OK) == 0){
+		tree_.load(snapshotPath_);
+	}
+	WriteAheadLog::replay(logPath_, [this](const char* record, size_t size) {
+		applyRecord(record, size);
+	});
+	log_.open(logPath_);
+}
+
+/**
+* Replays one record. A record that is well formed (its checksum held)
+* but is not one this tree writes means the log belongs to some other
+* tree, which is an error rather than something to skip.
+*/
+template<class Key, class Value, class Compare>
+void DurableAVLTree<Key, Value, Compare>::applyRecord(const char* record, size_t size)
+{
+	if (size == 1 + sizeof(Key) + sizeof(Value) && record[0] == LOG_INSERT){
+		Key key;
+		Value value;
+		std::memcpy(&key, record + 1, sizeof(Key));
+		std::memcpy(&value, record + 1 + sizeof(Key), sizeof(Value));
+		tree_.insert(std::pair<const Key, Value>(key, value));
+	}
+	else if (size == 1 + sizeof(Key) && record[0] == LOG_REMOVE){
+		Key key;
+		std::memcpy(&key, record + 1, sizeof(Key));
+		tree_.remove(key);
+	}
+	else{
+		throw std::runtime_error("recover: " + logPath_ + " holds a record this tree did not write");
+	}
+}
+
+/**
+* Inserts or overwrites the item and returns once it is durable.
+*/
+template<class Key, class Value, class Compare>
+void DurableAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	char record[1 + sizeof(Key) + sizeof(Value)];
+	record[0] = LOG_INSERT;
+	std::memcpy(record + 1, &keyValuePair.first, sizeof(Key));
+	std::memcpy(record + 1 + sizeof(Key), &keyValuePair.second, sizeof(Value));
+	uint64_t sequence;
+	{
+		std::lock_guard<std::mutex> lock(treeLock_);
+		tree_.insert(keyValuePair);
+		sequence = log_.append(record, sizeof(record));
+	}
+	log_.sync(sequence);
+}
+
+/**
+* Removes the key, if present, and returns once that is durable.
+*/
+template<class Key, class Value, class Compare>
+void DurableAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+	char record[1 + sizeof(Key)];
+	record[0] = LOG_REMOVE;
+	std::memcpy(record + 1, &key, sizeof(Key));
+	uint64_t sequence;
+	{
+		std::lock_guard<std::mutex> lock(treeLock_);
+		tree_.remove(key);
+		sequence = log_.append(record, sizeof(record));
+	}
+	log_.sync(sequence);
+}
+
+/**
+* Saves a snapshot and empties the log, so the next start replays nothing.
+* The tree stays locked throughout, through the snapshot write and its
+* fsyncs, so readers as well as writers wait for the whole checkpoint.
+*
+* The snapshot is fully on disk and renamed into place before the log is
+* cut (see AVLTree::save()), so a crash at any point leaves either the old
+* snapshot and its log, or the new snapshot and a log it already holds.
+* Replaying that log over it is harmless: every record sets or clears one
+* key outright.
+*/
+template<class Key, class Value, class Compare>
+void DurableAVLTree<Key, Value, Compare>::checkpoint()
+{
+	std::lock_guard<std::mutex> lock(treeLock_);
+	tree_.save(snapshotPath_, true);
+	log_.truncate();
+}
+
+template<class Key, class Value, class Compare>
+bool DurableAVLTree<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+	std::lock_guard<std::mutex> lock(treeLock_);
+	typename BinarySearchTree<Key, Value, Compare>::iterator it = tree_.find(key);
+	if (it == tree_.end()){
+		return false;
+	}
+	value = it->second;
+	return true;
+}
+
+template<class Key, class Value, class Compare>
+bool DurableAVLTree<Key, Value, Compare>::contains(const Key& key) const
+{
+	std::lock_guard<std::mutex> lock(treeLock_);
+	return tree_.find(key) != tree_.end();
+}
+
+template<class Key, class Value, class Compare>
+size_t DurableAVLTree<Key, Value, Compare>::size() const
+{
+	std::lock_guard<std::mutex> lock(treeLock_);
+	return tree_.size();
+}
+
+template<class Key, class Value, class Compare>
+bool DurableAVLTree<Key, Value, Compare>::empty() const
+{
+	std::lock_guard<std::mutex> lock(treeLock_);
+	return tree_.empty();
+}
+
+template<class Key, class Value, class Compare>
+uint64_t DurableAVLTree<Key, Value, Compare>::loggedRecords() const
+{
+	return log_.records();
+}
+
+template<class Key, class Value, class Compare>
+uint64_t DurableAVLTree<Key, Value, Compare>::loggedSyncs() const
+{
+	return log_.syncs();
+}
+
+/*
+  -----------------------------------------------------
+  End implementations for the DurableAVLTree class.
+  -----------------------------------------------------
+*/
+
+#endif
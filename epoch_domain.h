@@ -0,0 +1,146 @@
+#ifndef EPOCH_DOMAIN_H
+#define EPOCH_DOMAIN_H
+
+#include <atomic>
+#include <cstddef>
+
+// Reader slots per domain. Threads beyond this share slots, which only
+// costs some cache-line traffic between them.
+static const std::size_t EPOCH_DOMAIN_SLOTS = 64;
+
+/**
+ * Epoch-based memory reclamation for a structure with lock-free readers
+ * and one writer at a time.
+ *
+ * Readers bracket each access with a Guard, which counts them in against
+ * the current epoch. The writer retires unlinked memory into the current
+ * epoch's list, and may free the previous epoch's list once drained()
+ * reports that no reader from that epoch is left, then advance(). Reader
+ * counters live in per-thread slots so readers do not contend on one
+ * cache line.
+ */
+class EpochDomain
+{
+public:
+    EpochDomain();
+
+    unsigned enter();
+    void exit(unsigned epoch);
+
+    unsigned epoch() const;
+    bool drained(unsigned epoch) const;
+    void advance();
+
+    /**
+     * Keeps memory reachable from the structure alive for its lifetime.
+     */
+    class Guard
+    {
+    public:
+        explicit Guard(EpochDomain& domain);
+        ~Guard();
+    private:
+        Guard(const Guard& other);
+        Guard& operator=(const Guard& other);
+
+        EpochDomain& domain_;
+        unsigned epoch_;
+    };
+
+private:
+    // Not copyable: readers hold on to their slots.
+    EpochDomain(const EpochDomain& other);
+    EpochDomain& operator=(const EpochDomain& other);
+
+    // Readers active in epochs of each parity, padded to a cache line.
+    struct Slot
+    {
+        std::atomic<long> active[2];
+        char padding[64 - 2 * sizeof(std::atomic<long>)];
+    };
+
+    static std::size_t slotIndex();
+
+    Slot slots_[EPOCH_DOMAIN_SLOTS];
+    std::atomic<unsigned> epoch_;
+};
+
+inline EpochDomain::EpochDomain() :
+    epoch_(0)
+{
+	for (std::size_t i = 0; i < EPOCH_DOMAIN_SLOTS; ++i){
+		slots_[i].active[0].store(0, std::memory_order_relaxed);
+		slots_[i].active[1].store(0, std::memory_order_relaxed);
+	}
+}
+
+/**
+* Registers the calling thread as a reader in the current epoch and
+* returns that epoch, to be passed to exit(). Re-reads the epoch after
+* registering so a concurrent advance() cannot miss the reader.
+*/
+inline unsigned EpochDomain::enter()
+{
+	Slot& slot = slots_[slotIndex()];
+	for (;;){
+		unsigned e = epoch_.load();
+		slot.active[e & 1].fetch_add(1);
+		if (epoch_.load() == e){
+			return e;
+		}
+		slot.active[e & 1].fetch_sub(1);
+	}
+}
+
+inline void EpochDomain::exit(unsigned epoch)
+{
+	slots_[slotIndex()].active[epoch & 1].fetch_sub(1, std::memory_order_release);
+}
+
+inline unsigned EpochDomain::epoch() const
+{
+	return epoch_.load();
+}
+
+/**
+* True if no reader that entered in epoch (or any epoch of its parity
+* before it) is still active. Only meaningful for epoch() - 1.
+*/
+inline bool EpochDomain::drained(unsigned epoch) const
+{
+	for (std::size_t i = 0; i < EPOCH_DOMAIN_SLOTS; ++i){
+		if (slots_[i].active[epoch & 1].load() != 0){
+			return false;
+		}
+	}
+	return true;
+}
+
+inline void EpochDomain::advance()
+{
+	epoch_.fetch_add(1);
+}
+
+/**
+* Threads take slots round-robin the first time they read from any domain.
+*/
+inline std::size_t EpochDomain::slotIndex()
+{
+	static std::atomic<std::size_t> nextSlot(0);
+	static thread_local std::size_t slot = nextSlot.fetch_add(1) % EPOCH_DOMAIN_SLOTS;
+	return slot;
+}
+
+inline EpochDomain::Guard::Guard(EpochDomain& domain) :
+    domain_(domain),
+    epoch_(domain.enter())
+{
+
+}
+
+inline EpochDomain::Guard::~Guard()
+{
+	domain_.exit(epoch_);
+}
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef FILE_SYNC_H
+#define FILE_SYNC_H
+
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+* fsync()s the file at path, e.g. a snapshot before it replaces an older
+* one. Throws std::runtime_error on failure.
+*/
+inline void syncFile(const std::string& path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0 || fsync(fd) != 0){
+		if (fd >= 0){
+			::close(fd);
+		}
+		throw std::runtime_error("sync: cannot sync " + path);
+	}
+	::close(fd);
+}
+
+/**
+* fsync()s the directory holding path, so a file just created or renamed
+* there is found again after a crash.
+*/
+inline void syncDirectory(const std::string& path)
+{
+	std::string::size_type slash = path.rfind('/');
+	syncFile(slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash));
+}
+
+#endif
@@ -0,0 +1,419 @@
+#ifndef FROZEN_INDEX_H
+#define FROZEN_INDEX_H
+
+#include <stdexcept>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+/**
+* An immutable sorted index, as produced by BinarySearchTree::freeze().
+*
+* Keys and values sit in two plain arrays in Eytzinger (breadth-first)
+* order: the children of the item at position k (counting from 1) are at
+* 2k and 2k + 1. There are no pointers, so an index costs about
+* sizeof(Key) + sizeof(Value) per item. A lookup descends with
+* k = 2k + (keys[k] < key) and no data-dependent branch, and since the
+* next few levels of descendants are adjacent in memory, they can be
+* prefetched while the current comparison is still in flight.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class FrozenIndex
+{
+public:
+    FrozenIndex();
+    template<typename ForwardIt>
+    FrozenIndex(ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+
+    size_t size() const;
+    bool empty() const;
+    Compare keyCompare() const;
+
+    /**
+    * A bidirectional in-order iterator. *it is a pair of references into
+    * the key and value arrays.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key&, const Value&> reference;
+
+        /**
+        * Lets it->first and it->second work on the reference pair.
+        */
+        class pointer
+        {
+        public:
+            explicit pointer(const reference& item) : item_(item) {}
+            const reference* operator->() const { return &item_; }
+        private:
+            reference item_;
+        };
+
+        iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class FrozenIndex<Key, Value, Compare>;
+        iterator(size_t position, const FrozenIndex<Key, Value, Compare>* index);
+        size_t position_;   // 1-based Eytzinger position; 0 is end()
+        const FrozenIndex<Key, Value, Compare>* index_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lowerBound(const Key& key) const;
+    iterator upperBound(const Key& key) const;
+
+    Value const & operator[](const Key& key) const;
+
+protected:
+    static size_t nextPosition(size_t position, size_t count);
+    static size_t prevPosition(size_t position, size_t count);
+    static size_t firstPosition(size_t count);
+    static size_t lastPosition(size_t count);
+    static size_t stopPosition(size_t position);
+    template<bool Inclusive>
+    size_t searchPosition(const Key& key) const;
+
+    // Descendants PREFETCH_STRIDE levels down share about one cache line
+    static const size_t PREFETCH_STRIDE = (sizeof(Key) <= 4) ? 16 : (sizeof(Key) <= 8) ? 8 : 4;
+
+    // Eytzinger order, position k stored at index k - 1
+    std::vector<Key> keys_;
+    std::vector<Value> values_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------------------
+  Begin implementations for the FrozenIndex::iterator class.
+  -------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+FrozenIndex<Key, Value, Compare>::iterator::iterator() :
+    position_(0),
+    index_(NULL)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+FrozenIndex<Key, Value, Compare>::iterator::iterator(size_t position, const FrozenIndex<Key, Value, Compare>* index) :
+    position_(position),
+    index_(index)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator::reference
+FrozenIndex<Key, Value, Compare>::iterator::operator*() const
+{
+    return reference(index_->keys_[position_ - 1], index_->values_[position_ - 1]);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator::pointer
+FrozenIndex<Key, Value, Compare>::iterator::operator->() const
+{
+    return pointer(**this);
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenIndex<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return position_ == rhs.position_;
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenIndex<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return position_ != rhs.position_;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator&
+FrozenIndex<Key, Value, Compare>::iterator::operator++()
+{
+    position_ = nextPosition(position_, index_->keys_.size());
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator
+FrozenIndex<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Stepping back from end() lands on the last item.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator&
+FrozenIndex<Key, Value, Compare>::iterator::operator--()
+{
+    size_t count = index_->keys_.size();
+    position_ = (position_ == 0) ? lastPosition(count) : prevPosition(position_, count);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator
+FrozenIndex<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+  -----------------------------------------------------------
+  End implementations for the FrozenIndex::iterator class.
+  -----------------------------------------------------------
+*/
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the FrozenIndex class.
+  ----------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+FrozenIndex<Key, Value, Compare>::FrozenIndex() :
+    comp_()
+{
+
+}
+
+/**
+* Builds the index from [first, last), which must be sorted by comp with
+* no duplicate keys. Each item is copied once, straight to its slot.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+FrozenIndex<Key, Value, Compare>::FrozenIndex(ForwardIt first, ForwardIt last, const Compare& comp) :
+    comp_(comp)
+{
+	size_t count = std::distance(first, last);
+	std::vector<ForwardIt> slots(count);
+	size_t position = firstPosition(count);
+	for (ForwardIt it = first; it != last; ++it){
+		slots[position - 1] = it;
+		position = nextPosition(position, count);
+	}
+
+	keys_.reserve(count);
+	values_.reserve(count);
+	for (size_t i = 0; i < count; ++i){
+		keys_.push_back(slots[i]->first);
+		values_.push_back(slots[i]->second);
+	}
+}
+
+template<class Key, class Value, class Compare>
+size_t FrozenIndex<Key, Value, Compare>::size() const
+{
+	return keys_.size();
+}
+
+template<class Key, class Value, class Compare>
+bool FrozenIndex<Key, Value, Compare>::empty() const
+{
+	return keys_.empty();
+}
+
+template<class Key, class Value, class Compare>
+Compare FrozenIndex<Key, Value, Compare>::keyCompare() const
+{
+	return comp_;
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator
+FrozenIndex<Key, Value, Compare>::begin() const
+{
+	return iterator(firstPosition(keys_.size()), this);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator
+FrozenIndex<Key, Value, Compare>::end() const
+{
+	return iterator(0, this);
+}
+
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator
+FrozenIndex<Key, Value, Compare>::find(const Key& key) const
+{
+	size_t position = searchPosition<false>(key);
+	if (position == 0 || comp_(key, keys_[position - 1])){
+		return end();
+	}
+	return iterator(position, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator
+FrozenIndex<Key, Value, Compare>::lowerBound(const Key& key) const
+{
+	return iterator(searchPosition<false>(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value, class Compare>
+typename FrozenIndex<Key, Value, Compare>::iterator
+FrozenIndex<Key, Value, Compare>::upperBound(const Key& key) const
+{
+	return iterator(searchPosition<true>(key), this);
+}
+
+template<class Key, class Value, class Compare>
+Value const & FrozenIndex<Key, Value, Compare>::operator[](const Key& key) const
+{
+	iterator it = find(key);
+	if (it == end()) throw std::out_of_range("Invalid key");
+	return values_[it.position_ - 1];
+}
+
+/**
+* In-order successor of a position in a complete tree of count items, or
+* 0 past the last one: the leftmost position of the right subtree, or
+* else the nearest ancestor we are left of.
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenIndex<Key, Value, Compare>::nextPosition(size_t position, size_t count)
+{
+	if (2 * position + 1 <= count){
+		position = 2 * position + 1;
+		while (2 * position <= count){
+			position = 2 * position;
+		}
+		return position;
+	}
+	while (position & 1){
+		position >>= 1;
+	}
+	return position >> 1;
+}
+
+/**
+* Mirror image of nextPosition().
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenIndex<Key, Value, Compare>::prevPosition(size_t position, size_t count)
+{
+	if (2 * position <= count){
+		position = 2 * position;
+		while (2 * position + 1 <= count){
+			position = 2 * position + 1;
+		}
+		return position;
+	}
+	while ((position & 1) == 0){
+		position >>= 1;
+	}
+	return position >> 1;
+}
+
+template<class Key, class Value, class Compare>
+size_t FrozenIndex<Key, Value, Compare>::firstPosition(size_t count)
+{
+	if (count == 0){
+		return 0;
+	}
+	size_t position = 1;
+	while (2 * position <= count){
+		position = 2 * position;
+	}
+	return position;
+}
+
+template<class Key, class Value, class Compare>
+size_t FrozenIndex<Key, Value, Compare>::lastPosition(size_t count)
+{
+	if (count == 0){
+		return 0;
+	}
+	size_t position = 1;
+	while (2 * position + 1 <= count){
+		position = 2 * position + 1;
+	}
+	return position;
+}
+
+/**
+* A descent records each turn in the low bit of the position: 1 for
+* right, 0 for left. The answer is where the last left turn happened, so
+* shift off the trailing right turns and then that left turn itself.
+* Returns 0 if the descent never turned left.
+*/
+template<class Key, class Value, class Compare>
+size_t FrozenIndex<Key, Value, Compare>::stopPosition(size_t position)
+{
+#if defined(__GNUC__)
+	return position >> (__builtin_ctzll(~static_cast<unsigned long long>(position)) + 1);
+#else
+	while (position & 1){
+		position >>= 1;
+	}
+	return position >> 1;
+#endif
+}
+
+/**
+* Position of the first key not less than key (Inclusive false) or
+* greater than key (Inclusive true), or 0 if there is none.
+*/
+template<class Key, class Value, class Compare>
+template<bool Inclusive>
+size_t FrozenIndex<Key, Value, Compare>::searchPosition(const Key& key) const
+{
+	const Key* keys = keys_.data();
+	size_t count = keys_.size();
+	size_t position = 1;
+	while (position <= count){
+#if defined(__GNUC__)
+		if (PREFETCH_STRIDE * position <= count){
+			__builtin_prefetch(keys + PREFETCH_STRIDE * position - 1);
+		}
+#endif
+		bool goRight = Inclusive ? !comp_(key, keys[position - 1]) : comp_(keys[position - 1], key);
+		position = 2 * position + goRight;
+	}
+	return stopPosition(position);
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the FrozenIndex class.
+  --------------------------------------------------
+*/
+
+#endif
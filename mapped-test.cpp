@@ -0,0 +1,242 @@
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <string>
+#include <iterator>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include "mapped_tree.h"
+
+using namespace std;
+
+/**
+* Checks MappedTree against std::map: lookups, bound queries and
+* iteration both ways over files written at sizes around a page of nodes,
+* and the errors write() and open() report. Writes its files to the
+* current directory.
+*/
+
+typedef MappedTree<uint64_t, uint64_t> Tree;
+typedef map<uint64_t, uint64_t> Map;
+
+static const string treePath = "mapped-test.tree";
+
+static int failures = 0;
+
+void report(const string& msg, bool ok)
+{
+    cout << msg << ": " << (ok ? "ok" : "FAILED") << endl;
+    if(!ok) {
+        ++failures;
+    }
+}
+
+/**
+* Reports whether it is end() exactly when want is expected.end(), and
+* otherwise points at the same item.
+*/
+bool sameItem(const Tree& tree, Tree::iterator it, const Map& expected, Map::const_iterator want)
+{
+    if(want == expected.end()) {
+        return it == tree.end();
+    }
+    return it != tree.end() && it->first == want->first && it->second == want->second;
+}
+
+/**
+* Writes n items with keys 3i + 1, so every key has a gap on both sides,
+* maps the file and compares everything with std::map.
+*/
+bool matchesMap(size_t n)
+{
+    Map expected;
+    for(uint64_t i = 0; i < n; ++i) {
+        expected[3 * i + 1] = i * 7;
+    }
+    Tree::write(treePath, expected.begin(), expected.end());
+    Tree tree(treePath);
+    if(tree.size() != n || tree.empty() != (n == 0)) {
+        return false;
+    }
+
+    // Forward, then backward from end()
+    Map::const_iterator want = expected.begin();
+    for(Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want) {
+        if(!sameItem(tree, it, expected, want)) {
+            return false;
+        }
+    }
+    if(want != expected.end()) {
+        return false;
+    }
+    Map::const_reverse_iterator back = expected.rbegin();
+    Tree::iterator it = tree.end();
+    for(size_t i = 0; i < n; ++i, ++back) {
+        --it;
+        if(it->first != back->first || it->second != back->second) {
+            return false;
+        }
+    }
+    if(it != tree.begin()) {
+        return false;
+    }
+
+    // Every key and every gap, including past both ends
+    for(uint64_t key = 0; key <= 3 * n + 2; ++key) {
+        Map::const_iterator upper = expected.upper_bound(key);
+        Map::const_iterator floorWant = (upper == expected.begin()) ? expected.end() : prev(upper);
+        if(!sameItem(tree, tree.find(key), expected, expected.find(key))
+           || !sameItem(tree, tree.lowerBound(key), expected, expected.lower_bound(key))
+           || !sameItem(tree, tree.ceiling(key), expected, expected.lower_bound(key))
+           || !sameItem(tree, tree.upperBound(key), expected, upper)
+           || !sameItem(tree, tree.floor(key), expected, floorWant)) {
+            return false;
+        }
+    }
+
+    // Ranges of a few widths from every start
+    for(uint64_t lo = 0; lo <= 3 * n + 2; lo += 5) {
+        uint64_t widths[] = { 0, 1, 3, 40, 1000 };
+        for(size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+            uint64_t hi = lo + widths[w];
+            size_t count = distance(expected.lower_bound(lo), expected.upper_bound(hi));
+            pair<Tree::iterator, Tree::iterator> range = tree.equalRange(lo, hi);
+            if(tree.countRange(lo, hi) != count || size_t(distance(range.first, range.second)) != count) {
+                return false;
+            }
+        }
+    }
+    return tree.equalRange(5, 4).first == tree.end() && tree.countRange(5, 4) == 0;
+}
+
+/**
+* Reports whether opening path throws std::runtime_error and leaves an
+* already open tree of 10 items readable.
+*/
+bool openFails(const string& path)
+{
+    Map expected;
+    for(uint64_t key = 0; key < 10; ++key) {
+        expected[key] = key;
+    }
+    Tree::write(treePath + ".good", expected.begin(), expected.end());
+    Tree tree(treePath + ".good");
+    bool threw = false;
+    try {
+        tree.open(path);
+    }
+    catch(const runtime_error&) {
+        threw = true;
+    }
+    bool intact = tree.size() == 10 && tree.find(9) != tree.end() && tree.find(9)->second == 9;
+    tree.close();
+    remove((treePath + ".good").c_str());
+    return threw && intact;
+}
+
+vector<char> readFile(const string& path)
+{
+    ifstream in(path.c_str(), ios::binary);
+    return vector<char>((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+void writeFile(const string& path, const vector<char>& bytes)
+{
+    ofstream out(path.c_str(), ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+int main()
+{
+    // A page holds a 7-level subtree of these 32-byte nodes. 255 items
+    // make a full 8-level tree, 256 and 257 start a ninth level, and 4097
+    // spans many page clusters
+    size_t sizes[] = { 0, 1, 2, 255, 256, 257, 4097 };
+    for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        report("lookups and iteration, n = " + to_string(sizes[i]), matchesMap(sizes[i]));
+    }
+
+    {
+        Map expected;
+        expected[1] = 1;
+        Tree::write(treePath, expected.begin(), expected.end());
+        Tree tree(treePath);
+        bool threw = false;
+        try {
+            tree[2];
+        }
+        catch(const out_of_range&) {
+            threw = true;
+        }
+        report("operator[] of a missing key", threw && tree[1] == 1);
+    }
+
+    // write() rejects input that is not strictly increasing
+    {
+        vector<pair<uint64_t, uint64_t> > unsorted;
+        unsorted.push_back(make_pair(uint64_t(2), uint64_t(0)));
+        unsorted.push_back(make_pair(uint64_t(1), uint64_t(0)));
+        bool threw = false;
+        try {
+            Tree::write(treePath + ".unsorted", unsorted.begin(), unsorted.end());
+        }
+        catch(const invalid_argument&) {
+            threw = true;
+        }
+        ifstream left((treePath + ".unsorted.tmp").c_str());
+        report("write of unsorted input", threw && !left);
+
+        unsorted[1].first = 2;
+        threw = false;
+        try {
+            Tree::write(treePath + ".unsorted", unsorted.begin(), unsorted.end());
+        }
+        catch(const invalid_argument&) {
+            threw = true;
+        }
+        report("write of a duplicate key", threw);
+    }
+
+    // open() rejects bad files and keeps the tree it had
+    {
+        Map expected;
+        for(uint64_t key = 0; key < 1000; ++key) {
+            expected[key] = key;
+        }
+        Tree::write(treePath, expected.begin(), expected.end());
+        vector<char> good = readFile(treePath);
+
+        report("open of a missing file", openFails(treePath + ".missing"));
+
+        vector<char> bytes = good;
+        bytes[0] ^= 1;
+        writeFile(treePath, bytes);
+        report("open of a file with a bad magic number", openFails(treePath));
+
+        bytes = good;
+        bytes.resize(good.size() - 1);
+        writeFile(treePath, bytes);
+        report("open of a truncated file", openFails(treePath));
+
+        bytes.resize(MAPPED_TREE_DATA - 1);
+        writeFile(treePath, bytes);
+        report("open of a file shorter than a header", openFails(treePath));
+
+        bytes = good;
+        MappedTreeHeader header;
+        memcpy(&header, bytes.data(), sizeof(header));
+        header.root = good.size();
+        memcpy(bytes.data(), &header, sizeof(header));
+        writeFile(treePath, bytes);
+        report("open of a file whose root lies past its end", openFails(treePath));
+
+        MappedTree<uint32_t, uint64_t>::write(treePath, expected.begin(), expected.end());
+        report("open of a file with another key size", openFails(treePath));
+    }
+
+    remove(treePath.c_str());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,738 @@
+#ifndef MAPPED_TREE_H
+#define MAPPED_TREE_H
+
+#include <stdexcept>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+#include <string>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+* The start of a MappedTree file. Offsets are in bytes from the start of
+* the file; root, first and last are 0 for an empty tree. nodeSize lets a
+* reader built with a different Key/Value layout reject the file.
+*/
+struct MappedTreeHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t keySize;
+    uint32_t valueSize;
+    uint32_t nodeSize;
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t fileSize;
+    uint64_t root;
+    uint64_t first;
+    uint64_t last;
+};
+
+static const uint32_t MAPPED_TREE_MAGIC = 0x5453424d;     // "MBST" when stored little-endian
+static const uint32_t MAPPED_TREE_VERSION = 1;
+// Nodes start here, past the header
+static const uint64_t MAPPED_TREE_DATA = 64;
+// Page size the node layout is clustered for
+static const uint64_t MAPPED_TREE_PAGE = 4096;
+// Set on a link that is a thread to the in-order neighbor, not a child
+static const uint64_t MAPPED_TREE_THREAD = 1;
+
+/**
+* A node as stored in a MappedTree file. links_[0] and links_[1] are the
+* file offsets of the left and right children. A missing child's link
+* instead holds the offset of the in-order predecessor (left) or successor
+* (right) with MAPPED_TREE_THREAD set, or just the flag past either end,
+* so iterators can step through the tree with neither parent links nor
+* a stack.
+*/
+template <typename Key, typename Value>
+struct MappedNode
+{
+    explicit MappedNode(const std::pair<const Key, Value>& item) : item_(item) {}
+
+    std::pair<const Key, Value> item_;
+    uint64_t links_[2];
+};
+
+/**
+* A read-only search tree kept in a file and used in place through a
+* read-only memory map: child links are file offsets rather than pointers,
+* so opening one does no parsing or allocation, and only the pages that
+* lookups and scans touch are ever read from disk. Files are written by
+* write() from any sorted range, e.g. the iterators of a BinarySearchTree.
+*
+* The tree has the balanced shape AVLTree::assignSorted() builds. In the
+* file, each subtree of the top few levels that fits in a page is stored
+* together in breadth-first order, starting on a fresh page when the
+* current one cannot hold it, and the subtrees hanging below it follow.
+* A lookup in n items thus touches about log2(n) / log2(items per page)
+* pages instead of one per level.
+*
+* Key and Value must be trivially copyable, and the file must be read by
+* a program with the same Key/Value layout and byte order.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class MappedTree
+{
+public:
+    MappedTree();
+    explicit MappedTree(const std::string& path, const Compare& comp = Compare());
+    ~MappedTree();
+
+    template<typename ForwardIt>
+    static void write(const std::string& path, ForwardIt first, ForwardIt last, const Compare& comp = Compare());
+    void open(const std::string& path);
+    void close();
+
+    size_t size() const;
+    bool empty() const;
+    Compare keyCompare() const;
+
+    /**
+    * A bidirectional in-order iterator over the mapped items.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class MappedTree<Key, Value, Compare>;
+        iterator(uint64_t offset, const MappedTree<Key, Value, Compare>* tree);
+        uint64_t offset_;   // of the current node; 0 is end()
+        const MappedTree<Key, Value, Compare>* tree_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+
+    // Ordered queries, with the same meaning as in BinarySearchTree
+    iterator lowerBound(const Key& key) const;
+    iterator upperBound(const Key& key) const;
+    iterator floor(const Key& key) const;
+    iterator ceiling(const Key& key) const;
+    std::pair<iterator, iterator> equalRange(const Key& lo, const Key& hi) const;
+    size_t countRange(const Key& lo, const Key& hi) const;
+
+    Value const & operator[](const Key& key) const;
+
+protected:
+    typedef MappedNode<Key, Value> NodeType;
+
+    const NodeType* nodeAt(uint64_t offset) const;
+    static bool validOffset(uint64_t offset, uint64_t count, uint64_t length);
+    const MappedTreeHeader* header() const;
+    template<bool Inclusive>
+    uint64_t searchOffset(const Key& key) const;
+    static uint64_t placeNodes(uint64_t count, std::vector<uint64_t>& offsets);
+    template<typename ForwardIt>
+    static void writeNodes(char* base, const std::vector<uint64_t>& offsets, ForwardIt& it, uint64_t lo,
+        uint64_t n, uint64_t count, const NodeType*& last, const Compare& comp);
+
+    // Not copyable: the tree owns its mapping
+    MappedTree(const MappedTree& other);
+    MappedTree& operator=(const MappedTree& other);
+
+    const char* base_;
+    size_t length_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------------------
+  Begin implementations for the MappedTree::iterator class.
+  -------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+MappedTree<Key, Value, Compare>::iterator::iterator() :
+    offset_(0),
+    tree_(NULL)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+MappedTree<Key, Value, Compare>::iterator::iterator(uint64_t offset, const MappedTree<Key, Value, Compare>* tree) :
+    offset_(offset),
+    tree_(tree)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator::reference
+MappedTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->nodeAt(offset_)->item_;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator::pointer
+MappedTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(tree_->nodeAt(offset_)->item_);
+}
+
+template<class Key, class Value, class Compare>
+bool MappedTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return offset_ == rhs.offset_;
+}
+
+template<class Key, class Value, class Compare>
+bool MappedTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return offset_ != rhs.offset_;
+}
+
+/**
+* Follows the right thread, or else goes to the leftmost node of the
+* right subtree.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator&
+MappedTree<Key, Value, Compare>::iterator::operator++()
+{
+    uint64_t link = tree_->nodeAt(offset_)->links_[1];
+    if (link & MAPPED_TREE_THREAD){
+        offset_ = link & ~MAPPED_TREE_THREAD;
+        return *this;
+    }
+    offset_ = link;
+    while (!((link = tree_->nodeAt(offset_)->links_[0]) & MAPPED_TREE_THREAD)){
+        offset_ = link;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Mirror image of operator++(). Stepping back from end() lands on the
+* last item.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator&
+MappedTree<Key, Value, Compare>::iterator::operator--()
+{
+    if (offset_ == 0){
+        offset_ = tree_->header()->last;
+        return *this;
+    }
+    uint64_t link = tree_->nodeAt(offset_)->links_[0];
+    if (link & MAPPED_TREE_THREAD){
+        offset_ = link & ~MAPPED_TREE_THREAD;
+        return *this;
+    }
+    offset_ = link;
+    while (!((link = tree_->nodeAt(offset_)->links_[1]) & MAPPED_TREE_THREAD)){
+        offset_ = link;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+  -----------------------------------------------------------
+  End implementations for the MappedTree::iterator class.
+  -----------------------------------------------------------
+*/
+
+/*
+  ----------------------------------------------------
+  Begin implementations for the MappedTree class.
+  ----------------------------------------------------
+*/
+
+/**
+* An empty tree with no file; open() maps one.
+*/
+template<class Key, class Value, class Compare>
+MappedTree<Key, Value, Compare>::MappedTree() :
+    base_(NULL),
+    length_(0),
+    comp_()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+MappedTree<Key, Value, Compare>::MappedTree(const std::string& path, const Compare& comp) :
+    base_(NULL),
+    length_(0),
+    comp_(comp)
+{
+	open(path);
+}
+
+template<class Key, class Value, class Compare>
+MappedTree<Key, Value, Compare>::~MappedTree()
+{
+	close();
+}
+
+/**
+* Writes the items of [first, last), which must be sorted by comp with no
+* duplicate keys, as a MappedTree file at path. The file is filled through
+* a writable mapping as path.tmp and renamed over path when complete.
+* Throws std::invalid_argument if the range is not strictly increasing,
+* and std::runtime_error if the file cannot be written.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+void MappedTree<Key, Value, Compare>::write(const std::string& path, ForwardIt first, ForwardIt last, const Compare& comp)
+{
+	static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+		"MappedTree stores keys and values as raw bytes");
+	uint64_t count = std::distance(first, last);
+	std::vector<uint64_t> offsets(count);
+	uint64_t fileSize = placeNodes(count, offsets);
+
+	std::string tmpPath = path + ".tmp";
+	int fd = ::open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0){
+		throw std::runtime_error("write: cannot open " + tmpPath);
+	}
+	// Reserve the blocks up front: a sparse file filled through the mapping
+	// would raise SIGBUS on a full disk rather than fail here.
+	if (posix_fallocate(fd, 0, fileSize) != 0){
+		::close(fd);
+		std::remove(tmpPath.c_str());
+		throw std::runtime_error("write: cannot reserve space for " + tmpPath);
+	}
+	void* map = mmap(NULL, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (map == MAP_FAILED){
+		std::remove(tmpPath.c_str());
+		throw std::runtime_error("write: cannot map " + tmpPath);
+	}
+	char* base = static_cast<char*>(map);
+
+	MappedTreeHeader* header = reinterpret_cast<MappedTreeHeader*>(base);
+	header->magic = MAPPED_TREE_MAGIC;
+	header->version = MAPPED_TREE_VERSION;
+	header->keySize = sizeof(Key);
+	header->valueSize = sizeof(Value);
+	header->nodeSize = sizeof(NodeType);
+	header->reserved = 0;
+	header->count = count;
+	header->fileSize = fileSize;
+	header->root = (count == 0) ? 0 : offsets[(count - 1) / 2];
+	header->first = (count == 0) ? 0 : offsets[0];
+	header->last = (count == 0) ? 0 : offsets[count - 1];
+
+	try {
+		ForwardIt it = first;
+		const NodeType* lastNode = NULL;
+		writeNodes(base, offsets, it, 0, count, count, lastNode, comp);
+	}
+	catch (...) {
+		munmap(map, fileSize);
+		std::remove(tmpPath.c_str());
+		throw;
+	}
+	bool written = (msync(map, fileSize, MS_SYNC) == 0);
+	munmap(map, fileSize);
+	if (!written || std::rename(tmpPath.c_str(), path.c_str()) != 0){
+		std::remove(tmpPath.c_str());
+		throw std::runtime_error("write: cannot write " + path);
+	}
+}
+
+/**
+* Maps the file at path read-only in place of any file mapped now. Checks
+* the header only, including that its node offsets lie inside the file;
+* the nodes are not read until used. Throws std::runtime_error, leaving
+* the tree as it was, if the file is missing, of another format version or
+* Key/Value layout, truncated, or its header is corrupt.
+*/
+template<class Key, class Value, class Compare>
+void MappedTree<Key, Value, Compare>::open(const std::string& path)
+{
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0){
+		throw std::runtime_error("open: cannot open " + path);
+	}
+	struct stat info;
+	void* map = MAP_FAILED;
+	size_t length = 0;
+	if (fstat(fd, &info) == 0 && static_cast<uint64_t>(info.st_size) >= MAPPED_TREE_DATA){
+		length = info.st_size;
+		map = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (map == MAP_FAILED){
+		throw std::runtime_error("open: " + path + " is not a MappedTree file");
+	}
+
+	const MappedTreeHeader* header = static_cast<const MappedTreeHeader*>(map);
+	const char* error = NULL;
+	if (header->magic != MAPPED_TREE_MAGIC){
+		error = " is not a MappedTree file";
+	}
+	else if (header->version != MAPPED_TREE_VERSION){
+		error = " has an unsupported format version";
+	}
+	else if (header->keySize != sizeof(Key) || header->valueSize != sizeof(Value) || header->nodeSize != sizeof(NodeType)){
+		error = " does not match this tree's key or value type";
+	}
+	else if (header->fileSize != length){
+		error = " is truncated";
+	}
+	else if (header->count > (length - MAPPED_TREE_DATA) / sizeof(NodeType)
+		|| !validOffset(header->root, header->count, length)
+		|| !validOffset(header->first, header->count, length)
+		|| !validOffset(header->last, header->count, length)){
+		error = " has a corrupt header";
+	}
+	if (error != NULL){
+		munmap(map, length);
+		throw std::runtime_error("open: " + path + error);
+	}
+
+	// Lookups jump between page clusters, so readahead mostly reads pages
+	// that are never used.
+	madvise(map, length, MADV_RANDOM);
+	close();
+	base_ = static_cast<const char*>(map);
+	length_ = length;
+}
+
+/**
+* Unmaps the file, leaving an empty tree. Iterators into it become invalid.
+*/
+template<class Key, class Value, class Compare>
+void MappedTree<Key, Value, Compare>::close()
+{
+	if (base_ != NULL){
+		munmap(const_cast<char*>(base_), length_);
+		base_ = NULL;
+		length_ = 0;
+	}
+}
+
+template<class Key, class Value, class Compare>
+size_t MappedTree<Key, Value, Compare>::size() const
+{
+	return (base_ == NULL) ? 0 : header()->count;
+}
+
+template<class Key, class Value, class Compare>
+bool MappedTree<Key, Value, Compare>::empty() const
+{
+	return size() == 0;
+}
+
+template<class Key, class Value, class Compare>
+Compare MappedTree<Key, Value, Compare>::keyCompare() const
+{
+	return comp_;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::begin() const
+{
+	return iterator((base_ == NULL) ? 0 : header()->first, this);
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::end() const
+{
+	return iterator(0, this);
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::find(const Key& key) const
+{
+	uint64_t offset = searchOffset<false>(key);
+	if (offset == 0 || comp_(key, nodeAt(offset)->item_.first)){
+		return end();
+	}
+	return iterator(offset, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::lowerBound(const Key& key) const
+{
+	return iterator(searchOffset<false>(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::upperBound(const Key& key) const
+{
+	return iterator(searchOffset<true>(key), this);
+}
+
+/**
+* Returns an iterator to the item with the largest key not greater than
+* key, or the end iterator if every key is greater.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::floor(const Key& key) const
+{
+	iterator it = upperBound(key);
+	if (it == begin()){
+		return end();
+	}
+	return --it;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTree<Key, Value, Compare>::iterator
+MappedTree<Key, Value, Compare>::ceiling(const Key& key) const
+{
+	return lowerBound(key);
+}
+
+/**
+* Returns the iterators [first, last) covering every key in [lo, hi].
+* An empty range (end, end) is returned if hi < lo.
+*/
+template<class Key, class Value, class Compare>
+std::pair<typename MappedTree<Key, Value, Compare>::iterator,
+          typename MappedTree<Key, Value, Compare>::iterator>
+MappedTree<Key, Value, Compare>::equalRange(const Key& lo, const Key& hi) const
+{
+	if (comp_(hi, lo)){
+		return std::make_pair(end(), end());
+	}
+	return std::make_pair(lowerBound(lo), upperBound(hi));
+}
+
+/**
+* Returns the number of keys in [lo, hi], walking the range.
+*/
+template<class Key, class Value, class Compare>
+size_t MappedTree<Key, Value, Compare>::countRange(const Key& lo, const Key& hi) const
+{
+	std::pair<iterator, iterator> range = equalRange(lo, hi);
+	size_t count = 0;
+	for (iterator it = range.first; it != range.second; ++it){
+		++count;
+	}
+	return count;
+}
+
+template<class Key, class Value, class Compare>
+Value const & MappedTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+	iterator it = find(key);
+	if (it == end()) throw std::out_of_range("Invalid key");
+	return it->second;
+}
+
+template<class Key, class Value, class Compare>
+const typename MappedTree<Key, Value, Compare>::NodeType*
+MappedTree<Key, Value, Compare>::nodeAt(uint64_t offset) const
+{
+	return reinterpret_cast<const NodeType*>(base_ + offset);
+}
+
+/**
+* True if a header offset can be used: 0 (no node) exactly when the tree is
+* empty, otherwise an aligned node wholly inside the data area.
+*/
+template<class Key, class Value, class Compare>
+bool MappedTree<Key, Value, Compare>::validOffset(uint64_t offset, uint64_t count, uint64_t length)
+{
+	if (count == 0 || offset == 0){
+		return count == 0 && offset == 0;
+	}
+	return offset >= MAPPED_TREE_DATA && offset <= length - sizeof(NodeType)
+		&& offset % alignof(NodeType) == 0;
+}
+
+template<class Key, class Value, class Compare>
+const MappedTreeHeader* MappedTree<Key, Value, Compare>::header() const
+{
+	return reinterpret_cast<const MappedTreeHeader*>(base_);
+}
+
+/**
+* Offset of the first node whose key is not less than key (Inclusive
+* false) or greater than key (Inclusive true), or 0 if there is none.
+*/
+template<class Key, class Value, class Compare>
+template<bool Inclusive>
+uint64_t MappedTree<Key, Value, Compare>::searchOffset(const Key& key) const
+{
+	if (base_ == NULL){
+		return 0;
+	}
+	uint64_t offset = header()->root;
+	uint64_t candidate = 0;
+	while (offset != 0){
+		const NodeType* node = nodeAt(offset);
+		bool goRight = Inclusive ? !comp_(key, node->item_.first) : comp_(node->item_.first, key);
+		if (!goRight){
+			candidate = offset;
+		}
+		uint64_t link = node->links_[goRight];
+		offset = (link & MAPPED_TREE_THREAD) ? 0 : link;
+	}
+	return candidate;
+}
+
+/**
+* Chooses the file offset of each of count nodes, indexed by in-order
+* rank, and returns the resulting file size. The subtree of ranks
+* [lo, lo + n) is rooted at rank lo + (n - 1) / 2, as in
+* AVLTree::buildSorted(). Working from the root, the top levels of each
+* subtree that fit in a page are laid out breadth-first, moving to the
+* next page first if they would straddle a page boundary, and the
+* subtrees below them are queued to be laid out the same way.
+*/
+template<class Key, class Value, class Compare>
+uint64_t MappedTree<Key, Value, Compare>::placeNodes(uint64_t count, std::vector<uint64_t>& offsets)
+{
+	int levels = 1;
+	while ((uint64_t(2) << levels) - 1 <= MAPPED_TREE_PAGE / sizeof(NodeType)){
+		++levels;
+	}
+
+	uint64_t next = MAPPED_TREE_DATA;
+	std::vector<std::pair<uint64_t, uint64_t> > pending;
+	std::vector<std::pair<uint64_t, uint64_t> > level, below;
+	if (count > 0){
+		pending.push_back(std::make_pair(uint64_t(0), count));
+	}
+	while (!pending.empty()){
+		std::pair<uint64_t, uint64_t> subtree = pending.back();
+		pending.pop_back();
+
+		uint64_t clusterNodes = std::min(subtree.second, (uint64_t(1) << levels) - 1);
+		uint64_t clusterBytes = clusterNodes * sizeof(NodeType);
+		uint64_t pageLeft = MAPPED_TREE_PAGE - next % MAPPED_TREE_PAGE;
+		if (clusterBytes > pageLeft && clusterBytes <= MAPPED_TREE_PAGE){
+			next += pageLeft;
+		}
+
+		level.assign(1, subtree);
+		for (int depth = 0; depth < levels && !level.empty(); ++depth){
+			below.clear();
+			for (size_t i = 0; i < level.size(); ++i){
+				uint64_t lo = level[i].first;
+				uint64_t n = level[i].second;
+				uint64_t leftCount = (n - 1) / 2;
+				uint64_t mid = lo + leftCount;
+				offsets[mid] = next;
+				next += sizeof(NodeType);
+				if (leftCount > 0){
+					below.push_back(std::make_pair(lo, leftCount));
+				}
+				if (n - 1 - leftCount > 0){
+					below.push_back(std::make_pair(mid + 1, n - 1 - leftCount));
+				}
+			}
+			level.swap(below);
+		}
+		// the last cluster level's children, pushed so the leftmost comes off first
+		pending.insert(pending.end(), level.rbegin(), level.rend());
+	}
+	return next;
+}
+
+/**
+* Copies the next n items of the range into the nodes for ranks
+* [lo, lo + n), in order, and links them: children by offset, and missing
+* children by a thread to rank mid - 1 or mid + 1. last is the node
+* written just before, whose key each new one must follow.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+void MappedTree<Key, Value, Compare>::writeNodes(char* base, const std::vector<uint64_t>& offsets, ForwardIt& it,
+	uint64_t lo, uint64_t n, uint64_t count, const NodeType*& last, const Compare& comp)
+{
+	if (n == 0){
+		return;
+	}
+	uint64_t leftCount = (n - 1) / 2;
+	uint64_t rightCount = n - 1 - leftCount;
+	uint64_t mid = lo + leftCount;
+	writeNodes(base, offsets, it, lo, leftCount, count, last, comp);
+
+	if (last != NULL && !comp(last->item_.first, it->first)){
+		throw std::invalid_argument("write: range is not strictly sorted by key");
+	}
+	NodeType* node = new (base + offsets[mid]) NodeType(*it);
+	++it;
+	last = node;
+	if (leftCount > 0){
+		node->links_[0] = offsets[lo + (leftCount - 1) / 2];
+	}
+	else{
+		node->links_[0] = ((mid == 0) ? 0 : offsets[mid - 1]) | MAPPED_TREE_THREAD;
+	}
+	if (rightCount > 0){
+		node->links_[1] = offsets[mid + 1 + (rightCount - 1) / 2];
+	}
+	else{
+		node->links_[1] = ((mid + 1 == count) ? 0 : offsets[mid + 1]) | MAPPED_TREE_THREAD;
+	}
+
+	writeNodes(base, offsets, it, mid + 1, rightCount, count, last, comp);
+}
+
+/*
+  --------------------------------------------------
+  End implementations for the MappedTree class.
+  --------------------------------------------------
+*/
+
+#endif
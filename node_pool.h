@@ -0,0 +1,189 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/**
+ * A slab allocator for the nodes of a single search tree.
+ *
+ * Blocks of one fixed size are carved out of large chunks. Freed blocks
+ * are pushed onto an intrusive free list and handed back out before any
+ * new memory is touched, and release() returns every chunk at once, so
+ * tearing down a tree costs O(chunks) rather than one free per node.
+ */
+class NodePool
+{
+public:
+    NodePool(std::size_t blockSize, std::size_t blockAlign);
+    ~NodePool();
+
+    void* allocate();
+    void deallocate(void* block);
+    void release();
+
+    std::size_t blockSize() const;
+    std::size_t blockAlign() const;
+
+private:
+    // Not copyable: the chunks belong to exactly one pool.
+    NodePool(const NodePool& other);
+    NodePool& operator=(const NodePool& other);
+
+    struct Chunk
+    {
+        Chunk* next;
+    };
+
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    void grow();
+
+    std::size_t blockSize_;
+    std::size_t blockAlign_;
+    std::size_t headerSize_;
+    std::size_t nextCapacity_;
+    Chunk* chunks_;
+    FreeBlock* freeList_;
+    char* bump_;
+    char* bumpEnd_;
+};
+
+// Number of blocks in the first chunk; later chunks double up to the max.
+static const std::size_t NODE_POOL_MIN_BLOCKS = 32;
+static const std::size_t NODE_POOL_MAX_BLOCKS = 8192;
+
+/**
+* Rounds n up to the next multiple of align (which must be a power of two).
+*/
+inline std::size_t nodePoolRoundUp(std::size_t n, std::size_t align)
+{
+	return (n + align - 1) & ~(align - 1);
+}
+
+/**
+* Creates an empty pool handing out blocks of at least blockSize bytes,
+* each aligned to blockAlign, even past what ::operator new guarantees
+* (see grow()). No memory is requested until the first allocate().
+*/
+inline NodePool::NodePool(std::size_t blockSize, std::size_t blockAlign) :
+    nextCapacity_(NODE_POOL_MIN_BLOCKS),
+    chunks_(NULL),
+    freeList_(NULL),
+    bump_(NULL),
+    bumpEnd_(NULL)
+{
+	if (blockAlign < alignof(FreeBlock)){
+		blockAlign = alignof(FreeBlock);
+	}
+	if (blockSize < sizeof(FreeBlock)){
+		blockSize = sizeof(FreeBlock);
+	}
+	blockSize_ = nodePoolRoundUp(blockSize, blockAlign);
+	blockAlign_ = blockAlign;
+	// The chunk link, then padding up to the first aligned block
+	headerSize_ = sizeof(Chunk) + blockAlign - 1;
+}
+
+/**
+* Frees every chunk. Objects still living in the pool are not destroyed.
+*/
+inline NodePool::~NodePool()
+{
+	release();
+}
+
+/**
+* Returns an uninitialized block, reusing a freed one when possible.
+*/
+inline void* NodePool::allocate()
+{
+	if (freeList_ != NULL){
+		FreeBlock* block = freeList_;
+		freeList_ = block->next;
+		return block;
+	}
+	if (bump_ == bumpEnd_){
+		grow();
+	}
+	void* block = bump_;
+	bump_ += blockSize_;
+	return block;
+}
+
+/**
+* Returns a block obtained from allocate() to the free list.
+*/
+inline void NodePool::deallocate(void* block)
+{
+	if (block == NULL){
+		return;
+	}
+	FreeBlock* freed = static_cast<FreeBlock*>(block);
+	freed->next = freeList_;
+	freeList_ = freed;
+}
+
+/**
+* Gives all chunks back to the system in one pass over the chunk list.
+* Every block previously handed out becomes invalid.
+*/
+inline void NodePool::release()
+{
+	while (chunks_ != NULL){
+		Chunk* next = chunks_->next;
+		::operator delete(chunks_);
+		chunks_ = next;
+	}
+	freeList_ = NULL;
+	bump_ = NULL;
+	bumpEnd_ = NULL;
+	nextCapacity_ = NODE_POOL_MIN_BLOCKS;
+}
+
+/**
+* Size in bytes of each block, after padding for alignment.
+*/
+inline std::size_t NodePool::blockSize() const
+{
+	return blockSize_;
+}
+
+/**
+* Alignment of each block, so a compatible pool can be made later.
+*/
+inline std::size_t NodePool::blockAlign() const
+{
+	return blockAlign_;
+}
+
+/**
+* Requests a new chunk and makes it the bump region. Chunk sizes grow
+* geometrically so small trees stay small and big trees make few requests.
+* ::operator new only aligns to alignof(std::max_align_t), so the first
+* block is placed at the next blockAlign boundary past the chunk link;
+* blockSize_ is a multiple of blockAlign, so the rest follow suit.
+*/
+inline void NodePool::grow()
+{
+	std::size_t capacity = nextCapacity_;
+	char* raw = static_cast<char*>(::operator new(headerSize_ + capacity * blockSize_));
+
+	Chunk* chunk = reinterpret_cast<Chunk*>(raw);
+	chunk->next = chunks_;
+	chunks_ = chunk;
+
+	std::uintptr_t first = nodePoolRoundUp(reinterpret_cast<std::uintptr_t>(raw + sizeof(Chunk)), blockAlign_);
+	bump_ = reinterpret_cast<char*>(first);
+	bumpEnd_ = bump_ + capacity * blockSize_;
+
+	if (nextCapacity_ < NODE_POOL_MAX_BLOCKS){
+		nextCapacity_ *= 2;
+	}
+}
+
+#endif
@@ -0,0 +1,127 @@
+#include <iostream>
+#include <map>
+#include <random>
+#include <cstdint>
+#include "path_avlbst.h"
+
+using namespace std;
+
+/**
+* Checks PathAVLTree against std::map: sorted and random inserts, random
+* removes, lookups and iteration through both a const and a non-const
+* tree.
+*/
+
+typedef PathAVLTree<uint32_t, uint64_t> Tree;
+
+static int failures = 0;
+
+void report(const char* msg, bool ok)
+{
+    cout << msg << ": " << (ok ? "ok" : "FAILED") << endl;
+    if(!ok) {
+        ++failures;
+    }
+}
+
+/**
+* Reports whether tree holds exactly the items of expected, in order,
+* by const and non-const iteration, find() and lowerBound().
+*/
+bool sameContents(Tree& tree, const map<uint32_t, uint64_t>& expected)
+{
+    if(tree.size() != expected.size() || tree.empty() != expected.empty()) {
+        return false;
+    }
+    map<uint32_t, uint64_t>::const_iterator want = expected.begin();
+    for(Tree::iterator it = tree.begin(); it != tree.end(); ++it, ++want) {
+        if(want == expected.end() || it->first != want->first || it->second != want->second) {
+            return false;
+        }
+    }
+    const Tree& constTree = tree;
+    want = expected.begin();
+    for(Tree::const_iterator it = constTree.cbegin(); it != constTree.cend(); ++it, ++want) {
+        if(want == expected.end() || it->first != want->first || it->second != want->second) {
+            return false;
+        }
+    }
+    for(want = expected.begin(); want != expected.end(); ++want) {
+        Tree::const_iterator it = constTree.find(want->first);
+        if(it == constTree.end() || it->second != want->second) {
+            return false;
+        }
+        // The gap just below each key leads lowerBound() to that key
+        if(want->first > 0 && expected.find(want->first - 1) == expected.end()
+           && constTree.lowerBound(want->first - 1) != it) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    // Sorted and reverse-sorted inserts take the top-down rotations at
+    // every level
+    {
+        Tree ascending;
+        Tree descending;
+        map<uint32_t, uint64_t> expected;
+        for(uint32_t i = 0; i < 5000; ++i) {
+            ascending.insert(make_pair(i, uint64_t(i) * 3));
+            descending.insert(make_pair(4999 - i, uint64_t(4999 - i) * 3));
+            expected[i] = uint64_t(i) * 3;
+        }
+        report("sorted inserts", sameContents(ascending, expected) && ascending.isBalanced());
+        report("reverse-sorted inserts", sameContents(descending, expected) && descending.isBalanced());
+    }
+
+    // Random inserts, overwrites and removes
+    {
+        Tree tree;
+        map<uint32_t, uint64_t> expected;
+        mt19937 rng(19);
+        bool ok = true;
+        bool balanced = true;
+        for(size_t i = 0; i < 200000 && ok; ++i) {
+            uint32_t key = rng() % 5000;
+            if(rng() % 3 == 0) {
+                tree.remove(key);
+                expected.erase(key);
+            }
+            else {
+                uint64_t value = rng();
+                tree.insert(make_pair(key, value));
+                expected[key] = value;
+            }
+            if(i % 10000 == 0) {
+                ok = sameContents(tree, expected);
+                balanced = balanced && tree.isBalanced();
+            }
+        }
+        report("random inserts and removes", ok && sameContents(tree, expected));
+        report("random inserts and removes stay balanced", balanced && tree.isBalanced());
+
+        const Tree& constTree = tree;
+        report("find of a missing key", tree.find(5000) == tree.end() && constTree.find(5000) == constTree.end());
+        report("lowerBound past the last key", constTree.lowerBound(5000) == constTree.end());
+
+        // Writes through a non-const iterator show through a const one
+        for(Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+            it->second = it->first + 1;
+        }
+        bool written = true;
+        for(Tree::const_iterator it = constTree.begin(); it != constTree.end(); ++it) {
+            written = written && it->second == it->first + 1;
+        }
+        Tree::const_iterator converted = tree.begin();
+        report("writes through iterator", written && converted == constTree.begin());
+
+        tree.clear();
+        expected.clear();
+        report("clear", sameContents(tree, expected) && tree.begin() == tree.end());
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,868 @@
+#ifndef PATH_AVLBST_H
+#define PATH_AVLBST_H
+
+#include <stdexcept>
+#include <functional>
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include "node_pool.h"
+
+/**
+* A node of a PathAVLTree: the item, two child links and the balance, with
+* no parent link. The links form an array so a descent can index it with
+* a comparison result.
+*/
+template <typename Key, typename Value>
+class PathAVLNode
+{
+public:
+    PathAVLNode(const Key& key, const Value& value);
+
+    const std::pair<const Key, Value>& getItem() const;
+    std::pair<const Key, Value>& getItem();
+    const Key& getKey() const;
+    Value& getValue();
+    void setValue(const Value& value);
+
+    PathAVLNode<Key, Value>* getLeft() const;
+    PathAVLNode<Key, Value>* getRight() const;
+    PathAVLNode<Key, Value>* getChild(bool right) const;
+    void setChild(bool right, PathAVLNode<Key, Value>* child);
+
+    int8_t getBalance() const;
+    void setBalance(int8_t balance);
+    void updateBalance(int8_t diff);
+
+protected:
+    std::pair<const Key, Value> item_;
+    PathAVLNode<Key, Value>* children_[2];  // left, then right
+    int8_t balance_;
+};
+
+/*
+  ---------------------------------------------------------
+  Begin implementations for the PathAVLNode class.
+  ---------------------------------------------------------
+*/
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>::PathAVLNode(const Key& key, const Value& value) :
+    item_(key, value),
+    balance_(0)
+{
+    children_[0] = NULL;
+    children_[1] = NULL;
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& PathAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+std::pair<const Key, Value>& PathAVLNode<Key, Value>::getItem()
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& PathAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+Value& PathAVLNode<Key, Value>::getValue()
+{
+    return item_.second;
+}
+
+template<class Key, class Value>
+void PathAVLNode<Key, Value>::setValue(const Value& value)
+{
+    item_.second = value;
+}
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>* PathAVLNode<Key, Value>::getLeft() const
+{
+    return children_[0];
+}
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>* PathAVLNode<Key, Value>::getRight() const
+{
+    return children_[1];
+}
+
+template<class Key, class Value>
+PathAVLNode<Key, Value>* PathAVLNode<Key, Value>::getChild(bool right) const
+{
+    return children_[right];
+}
+
+template<class Key, class Value>
+void PathAVLNode<Key, Value>::setChild(bool right, PathAVLNode<Key, Value>* child)
+{
+    children_[right] = child;
+}
+
+template<class Key, class Value>
+int8_t PathAVLNode<Key, Value>::getBalance() const
+{
+    return balance_;
+}
+
+template<class Key, class Value>
+void PathAVLNode<Key, Value>::setBalance(int8_t balance)
+{
+    balance_ = balance;
+}
+
+template<class Key, class Value>
+void PathAVLNode<Key, Value>::updateBalance(int8_t diff)
+{
+    balance_ += diff;
+}
+
+/*
+  -------------------------------------------------------
+  End implementations for the PathAVLNode class.
+  -------------------------------------------------------
+*/
+
+/**
+* An AVL tree whose nodes keep no parent pointer. insert() works top down:
+* on the way to the new leaf it remembers the deepest node that was not
+* balanced, which is the only place a rotation can be needed, and then
+* fixes balances from there down. remove() records its search path in a
+* local array and walks back up it. A uint64_t to uint64_t node is 40
+* bytes against 56 for AVLNode, and a rotation rewrites two child links
+* instead of up to six links.
+*
+* Iterators carry their own ancestor stack, are forward-only and are
+* invalidated by any update.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class PathAVLTree
+{
+protected:
+    typedef PathAVLNode<Key, Value> NodeType;
+    // Taller than any AVL tree that fits in a 64-bit address space
+    static const size_t MAX_HEIGHT = 96;
+
+public:
+    PathAVLTree();
+    explicit PathAVLTree(const Compare& comp);
+    ~PathAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    size_t size() const;
+    bool empty() const;
+    int height() const;
+    bool isBalanced() const;
+    Compare keyCompare() const;
+
+    /**
+    * An in-order iterator holding the nodes whose items are still ahead
+    * of it, nearest last. Items are read-only here; iterator adds write
+    * access.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+    protected:
+        friend class PathAVLTree<Key, Value, Compare>;
+        void pushLeftSpine(NodeType* node);
+
+        std::vector<NodeType*> path_;
+    };
+
+    /**
+    * A const_iterator that can also write the value. Only a non-const
+    * tree hands these out; each converts to a const_iterator.
+    */
+    class iterator : public const_iterator
+    {
+    public:
+        typedef std::pair<const Key, Value>* pointer;
+        typedef std::pair<const Key, Value>& reference;
+
+        iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        iterator& operator++();
+        iterator operator++(int);
+
+    protected:
+        friend class PathAVLTree<Key, Value, Compare>;
+        explicit iterator(const_iterator it);
+    };
+
+    iterator begin();
+    iterator end();
+    iterator find(const Key& key);
+    iterator lowerBound(const Key& key);
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lowerBound(const Key& key) const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    NodeType* findNode(const Key& key) const;
+    NodeType* newNode(const std::pair<const Key, Value>& item);
+    void freeNode(NodeType* node);
+    void deleteTree(NodeType* node);
+    static NodeType* rotateLeft(NodeType* node);
+    static NodeType* rotateRight(NodeType* node);
+    static NodeType* rebalance(NodeType* node);
+    int heightAndBalance(NodeType* node, bool& balanced) const;
+
+    NodePool pool_;
+    NodeType* root_;
+    size_t size_;
+    Compare comp_;
+
+private:
+    // Not copyable: the nodes belong to pool_.
+    PathAVLTree(const PathAVLTree& other);
+    PathAVLTree& operator=(const PathAVLTree& other);
+};
+
+/*
+  ----------------------------------------------------------------
+  Begin implementations for the PathAVLTree::const_iterator class.
+  ----------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+PathAVLTree<Key, Value, Compare>::const_iterator::const_iterator()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator::reference
+PathAVLTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return path_.back()->getItem();
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator::pointer
+PathAVLTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return &(path_.back()->getItem());
+}
+
+template<class Key, class Value, class Compare>
+bool PathAVLTree<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    if (path_.empty() || rhs.path_.empty()){
+        return path_.empty() && rhs.path_.empty();
+    }
+    return path_.back() == rhs.path_.back();
+}
+
+template<class Key, class Value, class Compare>
+bool PathAVLTree<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator&
+PathAVLTree<Key, Value, Compare>::const_iterator::operator++()
+{
+	NodeType* node = path_.back();
+	path_.pop_back();
+	pushLeftSpine(node->getRight());
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator
+PathAVLTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
+}
+
+template<class Key, class Value, class Compare>
+void PathAVLTree<Key, Value, Compare>::const_iterator::pushLeftSpine(NodeType* node)
+{
+	for (; node != NULL; node = node->getLeft()){
+		path_.push_back(node);
+	}
+}
+
+/*
+  --------------------------------------------------------------
+  End implementations for the PathAVLTree::const_iterator class.
+  --------------------------------------------------------------
+*/
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the PathAVLTree::iterator class.
+  ----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+PathAVLTree<Key, Value, Compare>::iterator::iterator()
+{
+
+}
+
+/**
+* Takes over the path of an iterator made by a const member; only the
+* non-const members do this, so the tree may be written.
+*/
+template<class Key, class Value, class Compare>
+PathAVLTree<Key, Value, Compare>::iterator::iterator(const_iterator it) :
+    const_iterator(std::move(it))
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator::reference
+PathAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return this->path_.back()->getItem();
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator::pointer
+PathAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(this->path_.back()->getItem());
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator&
+PathAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+	const_iterator::operator++();
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator
+PathAVLTree<Key, Value, Compare>::iterator::operator++(int)
+{
+	iterator old(*this);
+	++(*this);
+	return old;
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the PathAVLTree::iterator class.
+  --------------------------------------------------------
+*/
+
+/*
+  ---------------------------------------------------
+  Begin implementations for the PathAVLTree class.
+  ---------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+PathAVLTree<Key, Value, Compare>::PathAVLTree() :
+    pool_(sizeof(NodeType), alignof(NodeType)),
+    root_(NULL),
+    size_(0),
+    comp_()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+PathAVLTree<Key, Value, Compare>::PathAVLTree(const Compare& comp) :
+    pool_(sizeof(NodeType), alignof(NodeType)),
+    root_(NULL),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+PathAVLTree<Key, Value, Compare>::~PathAVLTree()
+{
+	clear();
+}
+
+/**
+* Inserts the pair, overwriting the value if the key is present. The
+* descent notes the deepest unbalanced node on the path (top) and its
+* parent; every node below top is balanced, so after linking the leaf
+* each of them tilts toward it, and only top itself can end up at +-2.
+*/
+template<class Key, class Value, class Compare>
+void PathAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	const Key& key = keyValuePair.first;
+	NodeType* top = root_;
+	NodeType* topParent = NULL;
+	NodeType* parent = NULL;
+	NodeType* curr = root_;
+	bool dir = false;
+	while (curr != NULL){
+		bool goLeft = comp_(key, curr->getKey());
+		bool goRight = comp_(curr->getKey(), key);
+		if (!goLeft && !goRight){
+			curr->setValue(keyValuePair.second);
+			return;
+		}
+		if (curr->getBalance() != 0){
+			top = curr;
+			topParent = parent;
+		}
+		parent = curr;
+		dir = goRight;
+		curr = curr->getChild(goRight);
+	}
+
+	NodeType* node = newNode(keyValuePair);
+	if (parent == NULL){
+		root_ = node;
+		return;
+	}
+	parent->setChild(dir, node);
+
+	for (curr = top; curr != node; ){
+		bool goRight = comp_(curr->getKey(), key);
+		curr->updateBalance(goRight ? 1 : -1);
+		curr = curr->getChild(goRight);
+	}
+	if (top->getBalance() == 2 || top->getBalance() == -2){
+		NodeType* subtree = rebalance(top);
+		if (topParent == NULL){
+			root_ = subtree;
+		}
+		else{
+			topParent->setChild(topParent->getRight() == top, subtree);
+		}
+	}
+}
+
+/**
+* Removes key if present. The path from the root is kept in a local
+* stack with the direction taken at each node; a node with two children
+* is replaced by its successor node, moved up whole, and then balances
+* are fixed walking back up the stack until a subtree keeps its height.
+*/
+template<class Key, class Value, class Compare>
+void PathAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+	NodeType* path[MAX_HEIGHT];
+	bool dirs[MAX_HEIGHT];
+	size_t depth = 0;
+
+	NodeType* curr = root_;
+	while (curr != NULL){
+		bool goLeft = comp_(key, curr->getKey());
+		bool goRight = comp_(curr->getKey(), key);
+		if (!goLeft && !goRight){
+			break;
+		}
+		path[depth] = curr;
+		dirs[depth++] = goRight;
+		curr = curr->getChild(goRight);
+	}
+	if (curr == NULL){
+		return;
+	}
+
+	if (curr->getLeft() != NULL && curr->getRight() != NULL){
+		size_t currDepth = depth;
+		path[depth] = curr;
+		dirs[depth++] = true;
+		NodeType* successor = curr->getRight();
+		while (successor->getLeft() != NULL){
+			path[depth] = successor;
+			dirs[depth++] = false;
+			successor = successor->getLeft();
+		}
+		path[depth - 1]->setChild(dirs[depth - 1], successor->getRight());
+		successor->setChild(false, curr->getLeft());
+		successor->setChild(true, curr->getRight());
+		successor->setBalance(curr->getBalance());
+		path[currDepth] = successor;
+		if (currDepth == 0){
+			root_ = successor;
+		}
+		else{
+			path[currDepth - 1]->setChild(dirs[currDepth - 1], successor);
+		}
+	}
+	else{
+		NodeType* replacement = (curr->getLeft() != NULL) ? curr->getLeft() : curr->getRight();
+		if (depth == 0){
+			root_ = replacement;
+		}
+		else{
+			path[depth - 1]->setChild(dirs[depth - 1], replacement);
+		}
+	}
+	freeNode(curr);
+
+	while (depth > 0){
+		--depth;
+		NodeType* node = path[depth];
+		node->updateBalance(dirs[depth] ? -1 : 1);
+		int8_t balance = node->getBalance();
+		if (balance == 1 || balance == -1){
+			break;
+		}
+		if (balance == 2 || balance == -2){
+			NodeType* subtree = rebalance(node);
+			if (depth == 0){
+				root_ = subtree;
+			}
+			else{
+				path[depth - 1]->setChild(dirs[depth - 1], subtree);
+			}
+			if (subtree->getBalance() != 0){
+				break;
+			}
+		}
+	}
+}
+
+/**
+* Destroys every item; when they need no destructor the nodes are never
+* visited and the pool hands its chunks back wholesale.
+*/
+template<class Key, class Value, class Compare>
+void PathAVLTree<Key, Value, Compare>::clear()
+{
+	if (!std::is_trivially_destructible<std::pair<const Key, Value> >::value){
+		deleteTree(root_);
+	}
+	pool_.release();
+	root_ = NULL;
+	size_ = 0;
+}
+
+template<class Key, class Value, class Compare>
+size_t PathAVLTree<Key, Value, Compare>::size() const
+{
+	return size_;
+}
+
+template<class Key, class Value, class Compare>
+bool PathAVLTree<Key, Value, Compare>::empty() const
+{
+	return size_ == 0;
+}
+
+template<class Key, class Value, class Compare>
+int PathAVLTree<Key, Value, Compare>::height() const
+{
+	bool balanced;
+	return heightAndBalance(root_, balanced);
+}
+
+/**
+* Checks every subtree against the AVL property and every stored balance
+* against the real heights.
+*/
+template<class Key, class Value, class Compare>
+bool PathAVLTree<Key, Value, Compare>::isBalanced() const
+{
+	bool balanced = true;
+	heightAndBalance(root_, balanced);
+	return balanced;
+}
+
+template<class Key, class Value, class Compare>
+Compare PathAVLTree<Key, Value, Compare>::keyCompare() const
+{
+	return comp_;
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator
+PathAVLTree<Key, Value, Compare>::begin()
+{
+	return iterator(cbegin());
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator
+PathAVLTree<Key, Value, Compare>::end()
+{
+	return iterator();
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator
+PathAVLTree<Key, Value, Compare>::find(const Key& key)
+{
+	return iterator(static_cast<const PathAVLTree<Key, Value, Compare>*>(this)->find(key));
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::iterator
+PathAVLTree<Key, Value, Compare>::lowerBound(const Key& key)
+{
+	return iterator(static_cast<const PathAVLTree<Key, Value, Compare>*>(this)->lowerBound(key));
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator
+PathAVLTree<Key, Value, Compare>::begin() const
+{
+	return cbegin();
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator
+PathAVLTree<Key, Value, Compare>::end() const
+{
+	return const_iterator();
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator
+PathAVLTree<Key, Value, Compare>::cbegin() const
+{
+	const_iterator it;
+	it.pushLeftSpine(root_);
+	return it;
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator
+PathAVLTree<Key, Value, Compare>::cend() const
+{
+	return const_iterator();
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator
+PathAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+	const_iterator it = lowerBound(key);
+	if (it != cend() && comp_(key, it->first)){
+		return cend();
+	}
+	return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key;
+* the nodes we turn left at are exactly the ones still ahead of it.
+*/
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::const_iterator
+PathAVLTree<Key, Value, Compare>::lowerBound(const Key& key) const
+{
+	const_iterator it;
+	NodeType* node = root_;
+	while (node != NULL){
+		if (comp_(node->getKey(), key)){
+			node = node->getRight();
+		}
+		else{
+			it.path_.push_back(node);
+			node = node->getLeft();
+		}
+	}
+	return it;
+}
+
+template<class Key, class Value, class Compare>
+Value& PathAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+	NodeType* node = findNode(key);
+	if (node == NULL) throw std::out_of_range("Invalid key");
+	return node->getValue();
+}
+
+template<class Key, class Value, class Compare>
+Value const & PathAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+	NodeType* node = findNode(key);
+	if (node == NULL) throw std::out_of_range("Invalid key");
+	return node->getValue();
+}
+
+/**
+* Three-way descent picking the next child by index, so the only branch
+* taken is the one out of the loop.
+*/
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::NodeType*
+PathAVLTree<Key, Value, Compare>::findNode(const Key& key) const
+{
+	NodeType* node = root_;
+	while (node != NULL){
+		bool goLeft = comp_(key, node->getKey());
+		bool goRight = comp_(node->getKey(), key);
+		if (!goLeft && !goRight){
+			return node;
+		}
+		node = node->getChild(goRight);
+	}
+	return NULL;
+}
+
+/**
+* Builds a node in a block taken from the pool. The block is returned if
+* construction throws.
+*/
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::NodeType*
+PathAVLTree<Key, Value, Compare>::newNode(const std::pair<const Key, Value>& item)
+{
+	void* block = pool_.allocate();
+	NodeType* node;
+	try {
+		node = new (block) NodeType(item.first, item.second);
+	}
+	catch (...) {
+		pool_.deallocate(block);
+		throw;
+	}
+	++size_;
+	return node;
+}
+
+template<class Key, class Value, class Compare>
+void PathAVLTree<Key, Value, Compare>::freeNode(NodeType* node)
+{
+	node->~NodeType();
+	pool_.deallocate(node);
+	--size_;
+}
+
+/**
+* Runs the destructor of every node below node. Recursion depth is bounded
+* by the tree height.
+*/
+template<class Key, class Value, class Compare>
+void PathAVLTree<Key, Value, Compare>::deleteTree(NodeType* node)
+{
+	if (node == NULL){
+		return;
+	}
+	deleteTree(node->getLeft());
+	deleteTree(node->getRight());
+	node->~NodeType();
+}
+
+/**
+* Rotates node's right child up and returns it, updating both balances
+* from the old ones.
+*/
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::NodeType*
+PathAVLTree<Key, Value, Compare>::rotateLeft(NodeType* node)
+{
+	NodeType* child = node->getRight();
+	node->setChild(true, child->getLeft());
+	child->setChild(false, node);
+
+	int nodeBalance = node->getBalance() - 1 - std::max<int>(child->getBalance(), 0);
+	int childBalance = child->getBalance() - 1 + std::min(nodeBalance, 0);
+	node->setBalance(static_cast<int8_t>(nodeBalance));
+	child->setBalance(static_cast<int8_t>(childBalance));
+	return child;
+}
+
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::NodeType*
+PathAVLTree<Key, Value, Compare>::rotateRight(NodeType* node)
+{
+	NodeType* child = node->getLeft();
+	node->setChild(false, child->getRight());
+	child->setChild(true, node);
+
+	int nodeBalance = node->getBalance() + 1 - std::min<int>(child->getBalance(), 0);
+	int childBalance = child->getBalance() + 1 + std::max(nodeBalance, 0);
+	node->setBalance(static_cast<int8_t>(nodeBalance));
+	child->setBalance(static_cast<int8_t>(childBalance));
+	return child;
+}
+
+/**
+* Fixes a node with balance +-2 by a single or double rotation and returns
+* the subtree's new root.
+*/
+template<class Key, class Value, class Compare>
+typename PathAVLTree<Key, Value, Compare>::NodeType*
+PathAVLTree<Key, Value, Compare>::rebalance(NodeType* node)
+{
+	if (node->getBalance() > 0){
+		if (node->getRight()->getBalance() < 0){
+			node->setChild(true, rotateRight(node->getRight()));
+		}
+		return rotateLeft(node);
+	}
+	if (node->getLeft()->getBalance() > 0){
+		node->setChild(false, rotateLeft(node->getLeft()));
+	}
+	return rotateRight(node);
+}
+
+template<class Key, class Value, class Compare>
+int PathAVLTree<Key, Value, Compare>::heightAndBalance(NodeType* node, bool& balanced) const
+{
+	if (node == NULL){
+		return 0;
+	}
+	int leftHeight = heightAndBalance(node->getLeft(), balanced);
+	int rightHeight = heightAndBalance(node->getRight(), balanced);
+	if (rightHeight - leftHeight != node->getBalance() || std::abs(rightHeight - leftHeight) > 1){
+		balanced = false;
+	}
+	return std::max(leftHeight, rightHeight) + 1;
+}
+
+/*
+  -------------------------------------------------
+  End implementations for the PathAVLTree class.
+  -------------------------------------------------
+*/
+
+#endif
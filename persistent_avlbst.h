@@ -0,0 +1,607 @@
+#ifndef PERSISTENT_AVLBST_H
+#define PERSISTENT_AVLBST_H
+
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <iterator>
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+
+/**
+* An immutable node of a PersistentAVLTree. Nodes never change once built,
+* so any number of trees (and threads) can share them; each holds a
+* reference on its children, and the last reference frees it.
+*/
+template <typename Key, typename Value>
+class PersistentAVLNode
+{
+public:
+    PersistentAVLNode(const std::pair<const Key, Value>& item,
+                      const PersistentAVLNode<Key, Value>* left,
+                      const PersistentAVLNode<Key, Value>* right);
+
+    const std::pair<const Key, Value>& getItem() const;
+    const Key& getKey() const;
+    const PersistentAVLNode<Key, Value>* getLeft() const;
+    const PersistentAVLNode<Key, Value>* getRight() const;
+    int getHeight() const;
+
+    static const PersistentAVLNode<Key, Value>* retain(const PersistentAVLNode<Key, Value>* node);
+    static void release(const PersistentAVLNode<Key, Value>* node);
+
+protected:
+    std::pair<const Key, Value> item_;
+    const PersistentAVLNode<Key, Value>* left_;
+    const PersistentAVLNode<Key, Value>* right_;
+    int height_;
+    mutable std::atomic<size_t> refs_;
+};
+
+/*
+  -----------------------------------------------------------
+  Begin implementations for the PersistentAVLNode class.
+  -----------------------------------------------------------
+*/
+
+/**
+* Takes over one reference on each child; starts with one reference,
+* owned by the caller.
+*/
+template<class Key, class Value>
+PersistentAVLNode<Key, Value>::PersistentAVLNode(const std::pair<const Key, Value>& item,
+                                                 const PersistentAVLNode<Key, Value>* left,
+                                                 const PersistentAVLNode<Key, Value>* right) :
+    item_(item),
+    left_(left),
+    right_(right),
+    height_(1 + std::max(left ? left->height_ : 0, right ? right->height_ : 0)),
+    refs_(1)
+{
+
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>& PersistentAVLNode<Key, Value>::getItem() const
+{
+    return item_;
+}
+
+template<class Key, class Value>
+const Key& PersistentAVLNode<Key, Value>::getKey() const
+{
+    return item_.first;
+}
+
+template<class Key, class Value>
+const PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getLeft() const
+{
+    return left_;
+}
+
+template<class Key, class Value>
+const PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::getRight() const
+{
+    return right_;
+}
+
+template<class Key, class Value>
+int PersistentAVLNode<Key, Value>::getHeight() const
+{
+    return height_;
+}
+
+/**
+* Adds a reference to node (which may be NULL) and returns it.
+*/
+template<class Key, class Value>
+const PersistentAVLNode<Key, Value>* PersistentAVLNode<Key, Value>::retain(const PersistentAVLNode<Key, Value>* node)
+{
+    if (node != nullptr){
+        node->refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+/**
+* Drops a reference to node, freeing it and releasing its children if it
+* was the last. Recursion depth is bounded by the tree height.
+*/
+template<class Key, class Value>
+void PersistentAVLNode<Key, Value>::release(const PersistentAVLNode<Key, Value>* node)
+{
+    if (node != nullptr && node->refs_.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        release(node->left_);
+        release(node->right_);
+        delete node;
+    }
+}
+
+/*
+  ---------------------------------------------------------
+  End implementations for the PersistentAVLNode class.
+  ---------------------------------------------------------
+*/
+
+/**
+* A persistent AVL tree. insert() and remove() copy only the nodes on the
+* search path and share everything else with the previous version, so
+* snapshot() is O(1): it returns a tree that keeps seeing the current
+* contents however this one changes afterwards.
+*
+* A snapshot may be read, copied and destroyed on another thread while
+* this tree keeps changing, since shared nodes are immutable and reference
+* counted. Each individual tree object still needs external locking if
+* more than one thread modifies it. Nodes keep no parent pointers;
+* iterators carry their own path instead and are forward-only.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class PersistentAVLTree
+{
+protected:
+    typedef PersistentAVLNode<Key, Value> NodeType;
+
+public:
+    PersistentAVLTree();
+    explicit PersistentAVLTree(const Compare& comp);
+    PersistentAVLTree(const PersistentAVLTree& other);
+    PersistentAVLTree& operator=(const PersistentAVLTree& other);
+    ~PersistentAVLTree();
+
+    PersistentAVLTree snapshot() const;
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    size_t size() const;
+    bool empty() const;
+    int height() const;
+    bool isBalanced() const;
+    Compare keyCompare() const;
+
+    /**
+    * A forward iterator over a tree version. Stays valid as long as some
+    * tree still holds that version, even if the tree it came from moved on.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const std::pair<const Key, Value>* pointer;
+        typedef const std::pair<const Key, Value>& reference;
+
+        const_iterator();
+
+        const std::pair<const Key, Value>& operator*() const;
+        const std::pair<const Key, Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+    protected:
+        friend class PersistentAVLTree<Key, Value, Compare>;
+        void pushLeftSpine(const NodeType* node);
+
+        // Nodes whose items are still ahead, nearest last
+        std::vector<const NodeType*> path_;
+    };
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lowerBound(const Key& key) const;
+
+protected:
+    const NodeType* insertAt(const NodeType* node, const std::pair<const Key, Value>& item, bool& added);
+    const NodeType* removeAt(const NodeType* node, const Key& key);
+    const NodeType* removeSmallest(const NodeType* node, const NodeType*& smallest);
+    static const NodeType* build(const std::pair<const Key, Value>& item, const NodeType* left, const NodeType* right);
+    static int heightOf(const NodeType* node);
+    bool checkBalance(const NodeType* node, int& height) const;
+
+    const NodeType* root_;
+    size_t size_;
+    Compare comp_;
+};
+
+/*
+  ----------------------------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  ----------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::const_iterator::const_iterator()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key, Value>&
+PersistentAVLTree<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return path_.back()->getItem();
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key, Value>*
+PersistentAVLTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return &(path_.back()->getItem());
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    if (path_.empty() || rhs.path_.empty()){
+        return path_.empty() && rhs.path_.empty();
+    }
+    return path_.back() == rhs.path_.back();
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* The next item is the smallest in the right subtree, if there is one, or
+* else the nearest ancestor whose left subtree we were in.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::const_iterator&
+PersistentAVLTree<Key, Value, Compare>::const_iterator::operator++()
+{
+	const NodeType* node = path_.back();
+	path_.pop_back();
+	pushLeftSpine(node->getRight());
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::const_iterator
+PersistentAVLTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+	const_iterator old(*this);
+	++(*this);
+	return old;
+}
+
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::const_iterator::pushLeftSpine(const NodeType* node)
+{
+	for (; node != nullptr; node = node->getLeft()){
+		path_.push_back(node);
+	}
+}
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree() :
+    root_(nullptr),
+    size_(0),
+    comp_()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const Compare& comp) :
+    root_(nullptr),
+    size_(0),
+    comp_(comp)
+{
+
+}
+
+/**
+* Shares other's current version; O(1).
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const PersistentAVLTree& other) :
+    root_(NodeType::retain(other.root_)),
+    size_(other.size_),
+    comp_(other.comp_)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>&
+PersistentAVLTree<Key, Value, Compare>::operator=(const PersistentAVLTree& other)
+{
+	const NodeType* old = root_;
+	root_ = NodeType::retain(other.root_);
+	size_ = other.size_;
+	comp_ = other.comp_;
+	NodeType::release(old);
+	return *this;
+}
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::~PersistentAVLTree()
+{
+	NodeType::release(root_);
+}
+
+/**
+* Returns a tree frozen at the current contents, sharing all nodes.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare> PersistentAVLTree<Key, Value, Compare>::snapshot() const
+{
+	return PersistentAVLTree(*this);
+}
+
+/**
+* Inserts the item, or replaces the value if the key is present, copying
+* the O(log n) nodes on the path to it.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+	bool added = false;
+	const NodeType* fresh = insertAt(root_, keyValuePair, added);
+	NodeType::release(root_);
+	root_ = fresh;
+	if (added){
+		++size_;
+	}
+}
+
+/**
+* Removes the key if present; a missing key copies nothing.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+	if (find(key) == end()){
+		return;
+	}
+	const NodeType* fresh = removeAt(root_, key);
+	NodeType::release(root_);
+	root_ = fresh;
+	--size_;
+}
+
+/**
+* Drops this tree's reference; nodes still held by snapshots survive.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::clear()
+{
+	NodeType::release(root_);
+	root_ = nullptr;
+	size_ = 0;
+}
+
+template<class Key, class Value, class Compare>
+size_t PersistentAVLTree<Key, Value, Compare>::size() const
+{
+	return size_;
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::empty() const
+{
+	return root_ == nullptr;
+}
+
+template<class Key, class Value, class Compare>
+int PersistentAVLTree<Key, Value, Compare>::height() const
+{
+	return heightOf(root_);
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::isBalanced() const
+{
+	int height;
+	return checkBalance(root_, height);
+}
+
+template<class Key, class Value, class Compare>
+Compare PersistentAVLTree<Key, Value, Compare>::keyCompare() const
+{
+	return comp_;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::const_iterator
+PersistentAVLTree<Key, Value, Compare>::begin() const
+{
+	const_iterator it;
+	it.pushLeftSpine(root_);
+	return it;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::const_iterator
+PersistentAVLTree<Key, Value, Compare>::end() const
+{
+	return const_iterator();
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::const_iterator
+PersistentAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+	const_iterator it = lowerBound(key);
+	if (it != end() && comp_(key, it->first)){
+		return end();
+	}
+	return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key.
+* Every node we turn left at is still ahead of the result, so it goes on
+* the path; the path stops at the last such node.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::const_iterator
+PersistentAVLTree<Key, Value, Compare>::lowerBound(const Key& key) const
+{
+	const_iterator it;
+	const NodeType* curr = root_;
+	while (curr != nullptr){
+		if (comp_(curr->getKey(), key)){
+			curr = curr->getRight();
+		}
+		else{
+			it.path_.push_back(curr);
+			curr = curr->getLeft();
+		}
+	}
+	return it;
+}
+
+/**
+* Returns a new version of the subtree at node with the item inserted,
+* owning one reference; node itself is left untouched.
+*/
+template<class Key, class Value, class Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeType*
+PersistentAVLTree<Key, Value, Compare>::insertAt(const NodeType* node, const std::pair<const Key, Value>& item, bool& added)
+{
+	if (node == nullptr){
+		added = true;
+		return new NodeType(item, nullptr, nullptr);
+	}
+	if (comp_(item.first, node->getKey())){
+		const NodeType* left = insertAt(node->getLeft(), item, added);
+		return build(node->getItem(), left, NodeType::retain(node->getRight()));
+	}
+	if (comp_(node->getKey(), item.first)){
+		const NodeType* right = insertAt(node->getRight(), item, added);
+		return build(node->getItem(), NodeType::retain(node->getLeft()), right);
+	}
+	return new NodeType(item, NodeType::retain(node->getLeft()), NodeType::retain(node->getRight()));
+}
+
+/**
+* Returns a new version of the subtree at node without key, which must be
+* present. A node with two children takes its successor's item.
+*/
+template<class Key, class Value, class Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeType*
+PersistentAVLTree<Key, Value, Compare>::removeAt(const NodeType* node, const Key& key)
+{
+	if (comp_(key, node->getKey())){
+		const NodeType* left = removeAt(node->getLeft(), key);
+		return build(node->getItem(), left, NodeType::retain(node->getRight()));
+	}
+	if (comp_(node->getKey(), key)){
+		const NodeType* right = removeAt(node->getRight(), key);
+		return build(node->getItem(), NodeType::retain(node->getLeft()), right);
+	}
+	if (node->getLeft() == nullptr){
+		return NodeType::retain(node->getRight());
+	}
+	if (node->getRight() == nullptr){
+		return NodeType::retain(node->getLeft());
+	}
+	const NodeType* smallest = nullptr;
+	const NodeType* right = removeSmallest(node->getRight(), smallest);
+	return build(smallest->getItem(), NodeType::retain(node->getLeft()), right);
+}
+
+/**
+* Returns a new version of the subtree at node without its smallest item,
+* and points smallest at the (old, still referenced) node that held it.
+*/
+template<class Key, class Value, class Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeType*
+PersistentAVLTree<Key, Value, Compare>::removeSmallest(const NodeType* node, const NodeType*& smallest)
+{
+	if (node->getLeft() == nullptr){
+		smallest = node;
+		return NodeType::retain(node->getRight());
+	}
+	const NodeType* left = removeSmallest(node->getLeft(), smallest);
+	return build(node->getItem(), left, NodeType::retain(node->getRight()));
+}
+
+/**
+* Builds a node for item over left and right (taking over their
+* references), rotating if their heights differ by two. Rotations copy
+* the nodes they move instead of relinking them, since those may be shared.
+*/
+template<class Key, class Value, class Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::NodeType*
+PersistentAVLTree<Key, Value, Compare>::build(const std::pair<const Key, Value>& item, const NodeType* left, const NodeType* right)
+{
+	int leftHeight = heightOf(left);
+	int rightHeight = heightOf(right);
+
+	if (leftHeight > rightHeight + 1){
+		const NodeType* outer = left->getLeft();
+		const NodeType* inner = left->getRight();
+		const NodeType* result;
+		if (heightOf(outer) >= heightOf(inner)){
+			result = new NodeType(left->getItem(), NodeType::retain(outer),
+				new NodeType(item, NodeType::retain(inner), right));
+		}
+		else{
+			result = new NodeType(inner->getItem(),
+				new NodeType(left->getItem(), NodeType::retain(outer), NodeType::retain(inner->getLeft())),
+				new NodeType(item, NodeType::retain(inner->getRight()), right));
+		}
+		NodeType::release(left);
+		return result;
+	}
+	if (rightHeight > leftHeight + 1){
+		const NodeType* outer = right->getRight();
+		const NodeType* inner = right->getLeft();
+		const NodeType* result;
+		if (heightOf(outer) >= heightOf(inner)){
+			result = new NodeType(right->getItem(),
+				new NodeType(item, left, NodeType::retain(inner)), NodeType::retain(outer));
+		}
+		else{
+			result = new NodeType(inner->getItem(),
+				new NodeType(item, left, NodeType::retain(inner->getLeft())),
+				new NodeType(right->getItem(), NodeType::retain(inner->getRight()), NodeType::retain(outer)));
+		}
+		NodeType::release(right);
+		return result;
+	}
+	return new NodeType(item, left, right);
+}
+
+template<class Key, class Value, class Compare>
+int PersistentAVLTree<Key, Value, Compare>::heightOf(const NodeType* node)
+{
+	return (node == nullptr) ? 0 : node->getHeight();
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::checkBalance(const NodeType* node, int& height) const
+{
+	if (node == nullptr){
+		height = 0;
+		return true;
+	}
+	int leftHeight, rightHeight;
+	if (!checkBalance(node->getLeft(), leftHeight) || !checkBalance(node->getRight(), rightHeight)){
+		return false;
+	}
+	height = std::max(leftHeight, rightHeight) + 1;
+	return height == node->getHeight() && std::abs(leftHeight - rightHeight) <= 1;
+}
+
+/*
+  --------------------------------------------------------
+  End implementations for the PersistentAVLTree class.
+  --------------------------------------------------------
+*/
+
+#endif
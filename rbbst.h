@@ -0,0 +1,526 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <cstdint>
+#include <utility>
+#include <functional>
+#include "bst.h"
+
+enum RBColor { RB_RED = 0, RB_BLACK = 1 };
+
+/**
+* A node of a red-black tree, adding the color to Node in a single byte:
+* an RBNode<uint64_t, uint64_t> is 48 bytes against 56 for AVLNode, which
+* also keeps a subtree size. The color cannot hide in a spare pointer bit,
+* since BinarySearchTree walks parent_ and the child links directly.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    template<typename... Args>
+    RBNode(RBNode<Key, Value>* parent, Args&&... args);
+    ~RBNode();
+
+    RBColor getColor() const;
+    void setColor(RBColor color);
+    bool isRed() const;
+
+    // Hide the Node versions so traversals stay in RBNodes; see AVLNode.
+    RBNode<Key, Value>* getParent() const;
+    RBNode<Key, Value>* getLeft() const;
+    RBNode<Key, Value>* getRight() const;
+
+protected:
+    uint8_t color_;     // an RBColor; new nodes start red
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent) :
+    Node<Key, Value>(key, value, parent), color_(RB_RED)
+{
+
+}
+
+/**
+* In-place constructor, forwarding the item's constructor arguments to Node.
+*/
+template<class Key, class Value>
+template<typename... Args>
+RBNode<Key, Value>::RBNode(RBNode<Key, Value>* parent, Args&&... args) :
+    Node<Key, Value>(parent, std::forward<Args>(args)...), color_(RB_RED)
+{
+
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+template<class Key, class Value>
+RBColor RBNode<Key, Value>::getColor() const
+{
+    return static_cast<RBColor>(color_);
+}
+
+template<class Key, class Value>
+void RBNode<Key, Value>::setColor(RBColor color)
+{
+    color_ = static_cast<uint8_t>(color);
+}
+
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return color_ == RB_RED;
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value>* RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A red-black tree. Its height is at most 2 log2(n + 1), against about
+* 1.44 log2(n) for AVLTree, so lookups may walk a little further, but an
+* insert makes at most two rotations and a remove at most three; the
+* rest of a fix-up is recoloring. AVLTree::removeFix, by contrast, can
+* rotate at every level on the way to the root.
+*
+* isBalanced() still applies the AVL height rule; use isRedBlack() to
+* check this tree's own invariants.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class RBTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    RBTree();
+    explicit RBTree(const Compare& comp);
+    virtual ~RBTree();
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void insert(std::pair<const Key, Value>&& new_item);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> tryEmplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> tryEmplace(Key&& key, Args&&... args);
+    virtual void remove(const Key& key);
+    bool isRedBlack() const;
+
+protected:
+    virtual void nodeSwap(RBNode<Key, Value>* n1, RBNode<Key, Value>* n2);
+    virtual void afterInsert(Node<Key, Value>* node);
+    virtual void destroyNode(Node<Key, Value>* node);
+    void rotateLeft(RBNode<Key, Value>* node);
+    void rotateRight(RBNode<Key, Value>* node);
+    void removeFix(RBNode<Key, Value>* node, RBNode<Key, Value>* parent, bool isLeft);
+    static bool isRed(RBNode<Key, Value>* node);
+    int blackHeight(RBNode<Key, Value>* node, bool& valid) const;
+};
+
+/*
+  --------------------------------------------
+  Begin implementations for the RBTree class.
+  --------------------------------------------
+*/
+
+/**
+* Default constructor; sizes the node pool for RBNodes.
+*/
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::RBTree() :
+    BinarySearchTree<Key, Value, Compare>(sizeof(RBNode<Key, Value>), alignof(RBNode<Key, Value>))
+{
+
+}
+
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::RBTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(sizeof(RBNode<Key, Value>), alignof(RBNode<Key, Value>), comp)
+{
+
+}
+
+/**
+* Destructor; clears here so that destroyNode() still dispatches to the RB version.
+*/
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::~RBTree()
+{
+	this->clear();
+}
+
+/**
+* Overwrites the value if the key is present, otherwise adds a red leaf
+* and restores the invariants in afterInsert().
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& new_item)
+{
+	this->template insertItem<RBNode<Key, Value> >(new_item);
+}
+
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::insert(std::pair<const Key, Value>&& new_item)
+{
+	this->template insertItem<RBNode<Key, Value> >(std::move(new_item));
+}
+
+/**
+* Same as BinarySearchTree::emplace(), but builds an RBNode.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+RBTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+	return this->template emplaceItem<RBNode<Key, Value> >(std::forward<Args>(args)...);
+}
+
+/**
+* Same as BinarySearchTree::tryEmplace(), building an RBNode.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+RBTree<Key, Value, Compare>::tryEmplace(const Key& key, Args&&... args)
+{
+	return this->template tryEmplaceItem<RBNode<Key, Value> >(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+RBTree<Key, Value, Compare>::tryEmplace(Key&& key, Args&&... args)
+{
+	return this->template tryEmplaceItem<RBNode<Key, Value> >(std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Removes key if present. A node with two children first trades places
+* with its predecessor, as in BinarySearchTree::remove(), so the node
+* unlinked always has at most one child. Taking out a black node leaves
+* its side one black short, which removeFix() makes up.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::remove(const Key& key)
+{
+	RBNode<Key, Value>* curr = static_cast<RBNode<Key, Value>*>(this->internalFind(key));
+	if (curr == nullptr){
+		return;
+	}
+	if (curr->getLeft() != nullptr && curr->getRight() != nullptr){
+		RBNode<Key, Value>* pred = static_cast<RBNode<Key, Value>*>(BinarySearchTree<Key, Value, Compare>::predecessor(curr));
+		nodeSwap(curr, pred);
+	}
+
+	RBNode<Key, Value>* child = (curr->getLeft() != nullptr) ? curr->getLeft() : curr->getRight();
+	RBNode<Key, Value>* parent = curr->getParent();
+	bool isLeft = (parent != nullptr && parent->getLeft() == curr);
+	if (parent == nullptr){
+		this->root_ = child;
+	}
+	else if (isLeft){
+		parent->setLeft(child);
+	}
+	else{
+		parent->setRight(child);
+	}
+	if (child != nullptr){
+		child->setParent(parent);
+	}
+
+	if (!curr->isRed()){
+		if (child != nullptr && child->isRed()){
+			child->setColor(RB_BLACK);
+		}
+		else if (parent != nullptr){
+			removeFix(child, parent, isLeft);
+		}
+	}
+	this->destroyNode(curr);
+}
+
+/**
+* Checks that the root is black, no red node has a red child, and every
+* path down to a missing child passes the same number of black nodes.
+*/
+template<class Key, class Value, class Compare>
+bool RBTree<Key, Value, Compare>::isRedBlack() const
+{
+	RBNode<Key, Value>* root = static_cast<RBNode<Key, Value>*>(this->root_);
+	if (isRed(root)){
+		return false;
+	}
+	bool valid = true;
+	blackHeight(root, valid);
+	return valid;
+}
+
+/**
+* Swaps two nodes' places in the tree; the colors belong to the places,
+* so they are swapped back.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::nodeSwap(RBNode<Key, Value>* n1, RBNode<Key, Value>* n2)
+{
+	BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
+	RBColor temp = n1->getColor();
+	n1->setColor(n2->getColor());
+	n2->setColor(temp);
+}
+
+/**
+* A new red leaf may sit below a red parent. While it does: a red uncle
+* means the grandparent can pass its black down to both children and the
+* problem moves up two levels; a black uncle is settled by one or two
+* rotations at the grandparent, which ends the fix-up.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
+{
+	RBNode<Key, Value>* curr = static_cast<RBNode<Key, Value>*>(node);
+	RBNode<Key, Value>* parent = curr->getParent();
+	while (parent != nullptr && parent->isRed()){
+		RBNode<Key, Value>* grandp = parent->getParent();
+		if (parent == grandp->getLeft()){
+			RBNode<Key, Value>* uncle = grandp->getRight();
+			if (isRed(uncle)){
+				parent->setColor(RB_BLACK);
+				uncle->setColor(RB_BLACK);
+				grandp->setColor(RB_RED);
+				curr = grandp;
+				parent = curr->getParent();
+				continue;
+			}
+			if (curr == parent->getRight()){
+				rotateLeft(parent);
+				curr = parent;
+				parent = curr->getParent();
+			}
+			parent->setColor(RB_BLACK);
+			grandp->setColor(RB_RED);
+			rotateRight(grandp);
+		}
+		else{
+			RBNode<Key, Value>* uncle = grandp->getLeft();
+			if (isRed(uncle)){
+				parent->setColor(RB_BLACK);
+				uncle->setColor(RB_BLACK);
+				grandp->setColor(RB_RED);
+				curr = grandp;
+				parent = curr->getParent();
+				continue;
+			}
+			if (curr == parent->getLeft()){
+				rotateRight(parent);
+				curr = parent;
+				parent = curr->getParent();
+			}
+			parent->setColor(RB_BLACK);
+			grandp->setColor(RB_RED);
+			rotateLeft(grandp);
+		}
+		break;
+	}
+	static_cast<RBNode<Key, Value>*>(this->root_)->setColor(RB_BLACK);
+}
+
+/**
+* Runs the RBNode destructor before returning the block to the pool.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+	static_cast<RBNode<Key, Value>*>(node)->~RBNode();
+	this->pool_->deallocate(node);
+}
+
+/**
+* Makes node's right child its parent.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::rotateLeft(RBNode<Key, Value>* node)
+{
+	RBNode<Key, Value>* child = node->getRight();
+	RBNode<Key, Value>* parent = node->getParent();
+	node->setRight(child->getLeft());
+	if (child->getLeft() != nullptr){
+		child->getLeft()->setParent(node);
+	}
+	child->setLeft(node);
+	node->setParent(child);
+	child->setParent(parent);
+	if (parent == nullptr){
+		this->root_ = child;
+	}
+	else if (parent->getLeft() == node){
+		parent->setLeft(child);
+	}
+	else{
+		parent->setRight(child);
+	}
+}
+
+/**
+* Makes node's left child its parent.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::rotateRight(RBNode<Key, Value>* node)
+{
+	RBNode<Key, Value>* child = node->getLeft();
+	RBNode<Key, Value>* parent = node->getParent();
+	node->setLeft(child->getRight());
+	if (child->getRight() != nullptr){
+		child->getRight()->setParent(node);
+	}
+	child->setRight(node);
+	node->setParent(child);
+	child->setParent(parent);
+	if (parent == nullptr){
+		this->root_ = child;
+	}
+	else if (parent->getLeft() == node){
+		parent->setLeft(child);
+	}
+	else{
+		parent->setRight(child);
+	}
+}
+
+/**
+* The subtree at node (possibly NULL), the isLeft child of parent, has
+* one black fewer on every path than its sibling. A red sibling is first
+* rotated up so the sibling is black. A black sibling with black children
+* turns red and the shortage moves up to parent; otherwise one or two
+* rotations at parent add a black on node's side and the fix-up ends.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::removeFix(RBNode<Key, Value>* node, RBNode<Key, Value>* parent, bool isLeft)
+{
+	while (parent != nullptr && !isRed(node)){
+		if (isLeft){
+			RBNode<Key, Value>* sibling = parent->getRight();
+			if (sibling->isRed()){
+				sibling->setColor(RB_BLACK);
+				parent->setColor(RB_RED);
+				rotateLeft(parent);
+				sibling = parent->getRight();
+			}
+			if (!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+				sibling->setColor(RB_RED);
+				node = parent;
+				parent = node->getParent();
+				isLeft = (parent != nullptr && parent->getLeft() == node);
+				continue;
+			}
+			if (!isRed(sibling->getRight())){
+				sibling->getLeft()->setColor(RB_BLACK);
+				sibling->setColor(RB_RED);
+				rotateRight(sibling);
+				sibling = parent->getRight();
+			}
+			sibling->setColor(parent->getColor());
+			parent->setColor(RB_BLACK);
+			sibling->getRight()->setColor(RB_BLACK);
+			rotateLeft(parent);
+		}
+		else{
+			RBNode<Key, Value>* sibling = parent->getLeft();
+			if (sibling->isRed()){
+				sibling->setColor(RB_BLACK);
+				parent->setColor(RB_RED);
+				rotateRight(parent);
+				sibling = parent->getLeft();
+			}
+			if (!isRed(sibling->getLeft()) && !isRed(sibling->getRight())){
+				sibling->setColor(RB_RED);
+				node = parent;
+				parent = node->getParent();
+				isLeft = (parent != nullptr && parent->getLeft() == node);
+				continue;
+			}
+			if (!isRed(sibling->getLeft())){
+				sibling->getRight()->setColor(RB_BLACK);
+				sibling->setColor(RB_RED);
+				rotateLeft(sibling);
+				sibling = parent->getLeft();
+			}
+			sibling->setColor(parent->getColor());
+			parent->setColor(RB_BLACK);
+			sibling->getLeft()->setColor(RB_BLACK);
+			rotateRight(parent);
+		}
+		return;
+	}
+	if (node != nullptr){
+		node->setColor(RB_BLACK);
+	}
+}
+
+/**
+* Missing children count as black.
+*/
+template<class Key, class Value, class Compare>
+bool RBTree<Key, Value, Compare>::isRed(RBNode<Key, Value>* node)
+{
+	return node != nullptr && node->isRed();
+}
+
+/**
+* Number of black nodes on each path from node down to a missing child;
+* clears valid if the paths disagree or a red node has a red child.
+*/
+template<class Key, class Value, class Compare>
+int RBTree<Key, Value, Compare>::blackHeight(RBNode<Key, Value>* node, bool& valid) const
+{
+	if (node == nullptr){
+		return 0;
+	}
+	if (node->isRed() && (isRed(node->getLeft()) || isRed(node->getRight()))){
+		valid = false;
+	}
+	int leftHeight = blackHeight(node->getLeft(), valid);
+	int rightHeight = blackHeight(node->getRight(), valid);
+	if (leftHeight != rightHeight){
+		valid = false;
+	}
+	return leftHeight + (node->isRed() ? 0 : 1);
+}
+
+/*
+  ------------------------------------------
+  End implementations for the RBTree class.
+  ------------------------------------------
+*/
+
+#endif
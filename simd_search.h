@@ -0,0 +1,190 @@
+#ifndef SIMD_SEARCH_H
+#define SIMD_SEARCH_H
+
+#include <functional>
+#include <cstddef>
+#include <cstdint>
+
+// Vector key search is compiled in when the target has the instructions
+// (e.g. -mavx2 or -march=native); define BST_NO_SIMD to force the scalar
+// loops everywhere.
+#if !defined(BST_NO_SIMD) && defined(__GNUC__) && defined(__AVX2__)
+#define BST_SIMD_AVX2 1
+#include <immintrin.h>
+#elif !defined(BST_NO_SIMD) && defined(__GNUC__) && defined(__SSE4_2__)
+#define BST_SIMD_SSE42 1
+#include <nmmintrin.h>
+#endif
+
+/**
+* Counts of the keys in a sorted block that order before key (countLess)
+* or not after it (countNotGreater), i.e. the lower_bound and
+* upper_bound positions. The scalar versions compare every key without
+* branching; for 32- and 64-bit integers under std::less, the overloads
+* below compare a vector of keys at once and count the mask bits.
+*/
+template<typename Key, typename Compare>
+inline size_t countLessScalar(const Key* keys, size_t count, const Key& key, const Compare& comp)
+{
+	size_t index = 0;
+	for (size_t i = 0; i < count; ++i){
+		index += comp(keys[i], key);
+	}
+	return index;
+}
+
+template<typename Key, typename Compare>
+inline size_t countNotGreaterScalar(const Key* keys, size_t count, const Key& key, const Compare& comp)
+{
+	size_t index = 0;
+	for (size_t i = 0; i < count; ++i){
+		index += !comp(key, keys[i]);
+	}
+	return index;
+}
+
+template<typename Key, typename Compare>
+inline size_t countLess(const Key* keys, size_t count, const Key& key, const Compare& comp)
+{
+	return countLessScalar(keys, count, key, comp);
+}
+
+template<typename Key, typename Compare>
+inline size_t countNotGreater(const Key* keys, size_t count, const Key& key, const Compare& comp)
+{
+	return countNotGreaterScalar(keys, count, key, comp);
+}
+
+#if defined(BST_SIMD_AVX2) || defined(BST_SIMD_SSE42)
+
+/**
+* The vector compares are signed only, so unsigned keys have their top bit
+* flipped on both sides first, which preserves their order as signed.
+* Each step counts the lanes where keys[i] < key (or, for countNotGreater,
+* the lanes left after those where key < keys[i]). A count that is not a
+* multiple of the lane width ends with one more load aligned to the end
+* of the block, whose lanes already counted are shifted out of the mask.
+*/
+#if defined(BST_SIMD_AVX2)
+typedef __m256i SimdWord;
+inline SimdWord simdLoad(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+inline SimdWord simdXor(SimdWord a, SimdWord b) { return _mm256_xor_si256(a, b); }
+
+struct SimdLanes64
+{
+    static const size_t LANES = 4;
+    static SimdWord splat(int64_t x) { return _mm256_set1_epi64x(x); }
+    static int greater(SimdWord a, SimdWord b) { return _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(a, b))); }
+};
+
+struct SimdLanes32
+{
+    static const size_t LANES = 8;
+    static SimdWord splat(int32_t x) { return _mm256_set1_epi32(x); }
+    static int greater(SimdWord a, SimdWord b) { return _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(a, b))); }
+};
+#else
+typedef __m128i SimdWord;
+inline SimdWord simdLoad(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+inline SimdWord simdXor(SimdWord a, SimdWord b) { return _mm_xor_si128(a, b); }
+
+struct SimdLanes64
+{
+    static const size_t LANES = 2;
+    static SimdWord splat(int64_t x) { return _mm_set1_epi64x(x); }
+    static int greater(SimdWord a, SimdWord b) { return _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(a, b))); }
+};
+
+struct SimdLanes32
+{
+    static const size_t LANES = 4;
+    static SimdWord splat(int32_t x) { return _mm_set1_epi32(x); }
+    static int greater(SimdWord a, SimdWord b) { return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, b))); }
+};
+#endif
+
+template<typename Lanes, typename Key, typename Signed>
+inline size_t simdCountLess(const Key* keys, size_t count, Key key, Signed bias)
+{
+	if (count < Lanes::LANES){
+		return countLessScalar(keys, count, key, std::less<Key>());
+	}
+	SimdWord flip = Lanes::splat(bias);
+	SimdWord probe = Lanes::splat(static_cast<Signed>(key) ^ bias);
+	size_t index = 0;
+	size_t i = 0;
+	for (; i + Lanes::LANES <= count; i += Lanes::LANES){
+		index += __builtin_popcount(Lanes::greater(probe, simdXor(simdLoad(keys + i), flip)));
+	}
+	if (i < count){
+		size_t last = count - Lanes::LANES;
+		unsigned mask = Lanes::greater(probe, simdXor(simdLoad(keys + last), flip));
+		index += __builtin_popcount(mask >> (i - last));
+	}
+	return index;
+}
+
+template<typename Lanes, typename Key, typename Signed>
+inline size_t simdCountNotGreater(const Key* keys, size_t count, Key key, Signed bias)
+{
+	if (count < Lanes::LANES){
+		return countNotGreaterScalar(keys, count, key, std::less<Key>());
+	}
+	SimdWord flip = Lanes::splat(bias);
+	SimdWord probe = Lanes::splat(static_cast<Signed>(key) ^ bias);
+	size_t greater = 0;
+	size_t i = 0;
+	for (; i + Lanes::LANES <= count; i += Lanes::LANES){
+		greater += __builtin_popcount(Lanes::greater(simdXor(simdLoad(keys + i), flip), probe));
+	}
+	if (i < count){
+		size_t last = count - Lanes::LANES;
+		unsigned mask = Lanes::greater(simdXor(simdLoad(keys + last), flip), probe);
+		greater += __builtin_popcount(mask >> (i - last));
+	}
+	return count - greater;
+}
+
+inline size_t countLess(const int64_t* keys, size_t count, const int64_t& key, const std::less<int64_t>&)
+{
+	return simdCountLess<SimdLanes64>(keys, count, key, static_cast<int64_t>(0));
+}
+
+inline size_t countLess(const uint64_t* keys, size_t count, const uint64_t& key, const std::less<uint64_t>&)
+{
+	return simdCountLess<SimdLanes64>(keys, count, key, static_cast<int64_t>(INT64_MIN));
+}
+
+inline size_t countLess(const int32_t* keys, size_t count, const int32_t& key, const std::less<int32_t>&)
+{
+	return simdCountLess<SimdLanes32>(keys, count, key, static_cast<int32_t>(0));
+}
+
+inline size_t countLess(const uint32_t* keys, size_t count, const uint32_t& key, const std::less<uint32_t>&)
+{
+	return simdCountLess<SimdLanes32>(keys, count, key, static_cast<int32_t>(INT32_MIN));
+}
+
+inline size_t countNotGreater(const int64_t* keys, size_t count, const int64_t& key, const std::less<int64_t>&)
+{
+	return simdCountNotGreater<SimdLanes64>(keys, count, key, static_cast<int64_t>(0));
+}
+
+inline size_t countNotGreater(const uint64_t* keys, size_t count, const uint64_t& key, const std::less<uint64_t>&)
+{
+	return simdCountNotGreater<SimdLanes64>(keys, count, key, static_cast<int64_t>(INT64_MIN));
+}
+
+inline size_t countNotGreater(const int32_t* keys, size_t count, const int32_t& key, const std::less<int32_t>&)
+{
+	return simdCountNotGreater<SimdLanes32>(keys, count, key, static_cast<int32_t>(0));
+}
+
+inline size_t countNotGreater(const uint32_t* keys, size_t count, const uint32_t& key, const std::less<uint32_t>&)
+{
+	return simdCountNotGreater<SimdLanes32>(keys, count, key, static_cast<int32_t>(INT32_MIN));
+}
+
+#endif
+
+#endif
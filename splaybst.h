@@ -0,0 +1,393 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <stdexcept>
+#include <utility>
+#include <functional>
+#include <tuple>
+#include "bst.h"
+
+/**
+* A self-adjusting binary search tree (Sleator and Tarjan). Every find,
+* insert and remove splays the key it looks for to the root, so under
+* skewed access the hot keys gather near the top and are found in a few
+* steps, while any sequence of m operations still costs O(m log n).
+* There is no balance to keep, so the nodes are plain Nodes.
+*
+* The price is that every lookup rewrites links along its path, and the
+* next lookup depends on those writes. In bst-bench, AVLTree::find, which
+* only reads, stays ahead even on Zipf lookups. Keys that arrive in order
+* are where this tree wins: each insert is O(1) at the root.
+*
+* The splay is top-down: one pass from the root, splitting off the keys
+* below and above the target into two side trees, which are hung back
+* under the target at the end. It runs in a loop, so like height() and
+* isBalanced(), which keep an explicit stack, it is safe on the long
+* paths a splay tree can grow, e.g. n keys inserted in order form a
+* single chain until they are looked up. Only print() recurses, and only
+* through the PPBST_MAX_HEIGHT levels it draws.
+*
+* find() and operator[] restructure the tree and so are not const here;
+* on a const SplayTree they fall back to the BinarySearchTree versions,
+* which do not splay. The same goes for lowerBound() and the other
+* ordered queries.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class SplayTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    SplayTree();
+    explicit SplayTree(const Compare& comp);
+    virtual ~SplayTree();
+    virtual void insert(const std::pair<const Key, Value>& new_item);
+    virtual void insert(std::pair<const Key, Value>&& new_item);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> tryEmplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> tryEmplace(Key&& key, Args&&... args);
+    virtual void remove(const Key& key);
+
+    using BinarySearchTree<Key, Value, Compare>::find;
+    using BinarySearchTree<Key, Value, Compare>::operator[];
+    typename BinarySearchTree<Key, Value, Compare>::iterator find(const Key& key);
+    Value& operator[](const Key& key);
+
+protected:
+    Node<Key, Value>* splay(Node<Key, Value>* root, const Key& key);
+    bool rootHolds(const Key& key) const;
+    void linkRoot(Node<Key, Value>* node);
+    template<typename Item>
+    void insertSplayed(Item&& item);
+    template<typename K, typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool> tryEmplaceSplayed(K&& key, Args&&... args);
+};
+
+/*
+  ------------------------------------------------
+  Begin implementations for the SplayTree class.
+  ------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree() :
+    BinarySearchTree<Key, Value, Compare>()
+{
+
+}
+
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(comp)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::~SplayTree()
+{
+
+}
+
+/**
+* Splays the key to the root, then either overwrites its value or makes
+* a new root with the old one split between its children.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& new_item)
+{
+	insertSplayed(new_item);
+}
+
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::insert(std::pair<const Key, Value>&& new_item)
+{
+	insertSplayed(std::move(new_item));
+}
+
+/**
+* Same as BinarySearchTree::emplace(); the item, new or existing, ends up
+* at the root.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+SplayTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+	Node<Key, Value>* node = this->template constructNode<Node<Key, Value> >(nullptr, std::forward<Args>(args)...);
+	if (this->root_ != nullptr){
+		this->root_ = splay(this->root_, node->getKey());
+		if (rootHolds(node->getKey())){
+			this->destroyNode(node);
+			return std::make_pair(this->makeIterator(this->root_), false);
+		}
+	}
+	linkRoot(node);
+	return std::make_pair(this->makeIterator(node), true);
+}
+
+/**
+* Same as BinarySearchTree::tryEmplace(); the item, new or existing, ends
+* up at the root.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+SplayTree<Key, Value, Compare>::tryEmplace(const Key& key, Args&&... args)
+{
+	return tryEmplaceSplayed(key, std::forward<Args>(args)...);
+}
+
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+SplayTree<Key, Value, Compare>::tryEmplace(Key&& key, Args&&... args)
+{
+	return tryEmplaceSplayed(std::move(key), std::forward<Args>(args)...);
+}
+
+/**
+* Removes key if present. Once it is splayed to the root, splaying the
+* same key in its left subtree brings up the largest key there, which
+* has no right child and so can adopt the right subtree.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::remove(const Key& key)
+{
+	if (this->root_ == nullptr){
+		return;
+	}
+	this->root_ = splay(this->root_, key);
+	if (!rootHolds(key)){
+		return;
+	}
+	Node<Key, Value>* old = this->root_;
+	Node<Key, Value>* left = old->getLeft();
+	Node<Key, Value>* right = old->getRight();
+	if (left == nullptr){
+		this->root_ = right;
+		if (right != nullptr){
+			right->setParent(nullptr);
+		}
+	}
+	else{
+		left = splay(left, key);
+		left->setRight(right);
+		if (right != nullptr){
+			right->setParent(left);
+		}
+		this->root_ = left;
+	}
+	this->destroyNode(old);
+}
+
+/**
+* Returns an iterator to key, splayed to the root, or end() if it is
+* absent; then the last node visited is at the root instead.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+SplayTree<Key, Value, Compare>::find(const Key& key)
+{
+	if (this->root_ == nullptr){
+		return this->end();
+	}
+	this->root_ = splay(this->root_, key);
+	return rootHolds(key) ? this->makeIterator(this->root_) : this->end();
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key, splayed to the root
+ */
+template<class Key, class Value, class Compare>
+Value& SplayTree<Key, Value, Compare>::operator[](const Key& key)
+{
+	typename BinarySearchTree<Key, Value, Compare>::iterator it = find(key);
+	if (it == this->end()) throw std::out_of_range("Invalid key");
+	return it->second;
+}
+
+/**
+* Top-down splay of the non-empty subtree at root; returns its new root,
+* which holds key if the subtree does, otherwise the last node on key's
+* search path. Nodes passed on the way down are hung, in order, off the
+* bottom right of a tree of smaller keys or the bottom left of a tree of
+* larger ones, and two steps the same way are first rotated so the path
+* folds in half. Parent links are kept up as nodes move, and the returned
+* root has none.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* SplayTree<Key, Value, Compare>::splay(Node<Key, Value>* root, const Key& key)
+{
+	Node<Key, Value>* leftRoot = nullptr;
+	Node<Key, Value>* leftMax = nullptr;
+	Node<Key, Value>* rightRoot = nullptr;
+	Node<Key, Value>* rightMin = nullptr;
+	Node<Key, Value>* curr = root;
+	while (true){
+		if (this->comp_(key, curr->getKey())){
+			Node<Key, Value>* child = curr->getLeft();
+			if (child == nullptr){
+				break;
+			}
+			if (this->comp_(key, child->getKey())){
+				curr->setLeft(child->getRight());
+				if (child->getRight() != nullptr){
+					child->getRight()->setParent(curr);
+				}
+				child->setRight(curr);
+				curr->setParent(child);
+				curr = child;
+				if (curr->getLeft() == nullptr){
+					break;
+				}
+			}
+			if (rightMin == nullptr){
+				rightRoot = curr;
+			}
+			else{
+				rightMin->setLeft(curr);
+				curr->setParent(rightMin);
+			}
+			rightMin = curr;
+			curr = curr->getLeft();
+		}
+		else if (this->comp_(curr->getKey(), key)){
+			Node<Key, Value>* child = curr->getRight();
+			if (child == nullptr){
+				break;
+			}
+			if (this->comp_(child->getKey(), key)){
+				curr->setRight(child->getLeft());
+				if (child->getLeft() != nullptr){
+					child->getLeft()->setParent(curr);
+				}
+				child->setLeft(curr);
+				curr->setParent(child);
+				curr = child;
+				if (curr->getRight() == nullptr){
+					break;
+				}
+			}
+			if (leftMax == nullptr){
+				leftRoot = curr;
+			}
+			else{
+				leftMax->setRight(curr);
+				curr->setParent(leftMax);
+			}
+			leftMax = curr;
+			curr = curr->getRight();
+		}
+		else{
+			break;
+		}
+	}
+
+	if (leftMax != nullptr){
+		leftMax->setRight(curr->getLeft());
+		if (curr->getLeft() != nullptr){
+			curr->getLeft()->setParent(leftMax);
+		}
+		curr->setLeft(leftRoot);
+		leftRoot->setParent(curr);
+	}
+	if (rightMin != nullptr){
+		rightMin->setLeft(curr->getRight());
+		if (curr->getRight() != nullptr){
+			curr->getRight()->setParent(rightMin);
+		}
+		curr->setRight(rightRoot);
+		rightRoot->setParent(curr);
+	}
+	if (curr->getParent() != nullptr){
+		curr->setParent(nullptr);
+	}
+	return curr;
+}
+
+/**
+* True if the (just splayed) root holds key.
+*/
+template<class Key, class Value, class Compare>
+bool SplayTree<Key, Value, Compare>::rootHolds(const Key& key) const
+{
+	return !this->comp_(key, this->root_->getKey()) && !this->comp_(this->root_->getKey(), key);
+}
+
+/**
+* Makes node, whose key is absent, the root. The current root was splayed
+* for that key, so it is its neighbor: it goes below node on one side and
+* passes its child on the other side over to node.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::linkRoot(Node<Key, Value>* node)
+{
+	Node<Key, Value>* root = this->root_;
+	if (root != nullptr){
+		if (this->comp_(node->getKey(), root->getKey())){
+			node->setLeft(root->getLeft());
+			node->setRight(root);
+			root->setLeft(nullptr);
+		}
+		else{
+			node->setRight(root->getRight());
+			node->setLeft(root);
+			root->setRight(nullptr);
+		}
+		if (node->getLeft() != nullptr){
+			node->getLeft()->setParent(node);
+		}
+		if (node->getRight() != nullptr){
+			node->getRight()->setParent(node);
+		}
+	}
+	node->setParent(nullptr);
+	this->root_ = node;
+}
+
+/**
+* insert() on a splayed tree: overwrites the value of an existing key,
+* otherwise makes a new root from item.
+*/
+template<class Key, class Value, class Compare>
+template<typename Item>
+void SplayTree<Key, Value, Compare>::insertSplayed(Item&& item)
+{
+	if (this->root_ != nullptr){
+		this->root_ = splay(this->root_, item.first);
+		if (rootHolds(item.first)){
+			this->root_->getValue() = std::forward<Item>(item).second;
+			return;
+		}
+	}
+	linkRoot(this->template constructNode<Node<Key, Value> >(nullptr, std::forward<Item>(item)));
+}
+
+template<class Key, class Value, class Compare>
+template<typename K, typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+SplayTree<Key, Value, Compare>::tryEmplaceSplayed(K&& key, Args&&... args)
+{
+	if (this->root_ != nullptr){
+		this->root_ = splay(this->root_, key);
+		if (rootHolds(key)){
+			return std::make_pair(this->makeIterator(this->root_), false);
+		}
+	}
+	Node<Key, Value>* node = this->template constructNode<Node<Key, Value> >(nullptr, std::piecewise_construct,
+		std::forward_as_tuple(std::forward<K>(key)),
+		std::forward_as_tuple(std::forward<Args>(args)...));
+	linkRoot(node);
+	return std::make_pair(this->makeIterator(node), true);
+}
+
+/*
+  ----------------------------------------------
+  End implementations for the SplayTree class.
+  ----------------------------------------------
+*/
+
+#endif
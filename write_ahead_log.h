@@ -0,0 +1,323 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "file_sync.h"
+
+/**
+* CRC-32 (the zlib polynomial) of a record's length and bytes, so replay
+* can tell a record torn by a crash from a complete one.
+*/
+struct WalChecksumTable
+{
+    WalChecksumTable()
+    {
+        for (uint32_t i = 0; i < 256; ++i){
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit){
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320u : 0);
+            }
+            entries[i] = crc;
+        }
+    }
+    uint32_t entries[256];
+};
+
+/**
+* Pass the checksum of earlier bytes as crc to extend it over data.
+*/
+inline uint32_t walChecksum(const char* data, std::size_t size, uint32_t crc = 0)
+{
+	static const WalChecksumTable table;
+	crc = ~crc;
+	for (std::size_t i = 0; i < size; ++i){
+		crc = table.entries[(crc ^ static_cast<unsigned char>(data[i])) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+/**
+* An append-only log of opaque records, each framed by its length and
+* checksum. append() only copies a record into memory and numbers it;
+* sync(n) returns once records up to n are on disk.
+*
+* Syncs are grouped: the first waiting thread becomes the leader, and
+* writes and fdatasync()s every record appended so far in one go, while
+* later callers queue up behind it. Records appended during that sync
+* are all flushed by the next leader, so under concurrent writers one
+* disk flush commits a whole batch, and the batch grows as flushes slow
+* down.
+*/
+class WriteAheadLog
+{
+public:
+    WriteAheadLog();
+    ~WriteAheadLog();
+
+    void open(const std::string& path);
+    void close();
+
+    uint64_t append(const void* data, std::size_t size);
+    void sync(uint64_t sequence);
+    void truncate();
+
+    static std::size_t replay(const std::string& path, const std::function<void(const char*, std::size_t)>& apply);
+
+    // Totals since open(), e.g. records() / syncs() is the mean batch size
+    uint64_t records() const;
+    uint64_t syncs() const;
+
+private:
+    // Not copyable: the log owns its file.
+    WriteAheadLog(const WriteAheadLog& other);
+    WriteAheadLog& operator=(const WriteAheadLog& other);
+
+    static bool writeAll(int fd, const std::vector<char>& bytes);
+
+    int fd_;
+    mutable std::mutex lock_;
+    std::condition_variable synced_;
+    std::vector<char> pending_;     // appended, not yet handed to a leader
+    std::vector<char> flushing_;    // being written by the current leader
+    bool leader_;                   // a leader is writing flushing_
+    bool failed_;                   // a write or sync failed; the log is unusable
+    uint64_t appended_;             // sequence number of the last record appended
+    uint64_t durable_;              // ... and of the last one known to be on disk
+    uint64_t syncs_;
+};
+
+// Each record starts with its payload's length and checksum.
+static const std::size_t WAL_RECORD_HEADER = 2 * sizeof(uint32_t);
+
+/**
+* The checksum covers the length as well as the payload: a run of zero
+* bytes, as a crash can leave past the end of the file, would otherwise
+* read as an empty record whose checksum holds.
+*/
+inline uint32_t walRecordChecksum(uint32_t size, const char* payload)
+{
+	return walChecksum(payload, size, walChecksum(reinterpret_cast<const char*>(&size), sizeof(size)));
+}
+
+inline WriteAheadLog::WriteAheadLog() :
+    fd_(-1),
+    leader_(false),
+    failed_(false),
+    appended_(0),
+    durable_(0),
+    syncs_(0)
+{
+
+}
+
+/**
+* Flushes whatever is still pending before closing.
+*/
+inline WriteAheadLog::~WriteAheadLog()
+{
+	try {
+		close();
+	}
+	catch (...) {
+	}
+}
+
+/**
+* Opens path for appending, creating it if needed. Replay it first: new
+* records go after any already there. Throws std::runtime_error if the
+* file cannot be opened.
+*/
+inline void WriteAheadLog::open(const std::string& path)
+{
+	close();
+	bool existed = ::access(path.c_str(), F_OK) == 0;
+	int fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+	if (fd < 0){
+		throw std::runtime_error("open: cannot open log " + path);
+	}
+	if (!existed){
+		syncDirectory(path);
+	}
+	std::lock_guard<std::mutex> lock(lock_);
+	fd_ = fd;
+	failed_ = false;
+	appended_ = durable_ = syncs_ = 0;
+}
+
+/**
+* Syncs everything appended, then closes the file.
+*/
+inline void WriteAheadLog::close()
+{
+	if (fd_ < 0){
+		return;
+	}
+	uint64_t last;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		last = appended_;
+	}
+	bool synced = true;
+	try {
+		sync(last);
+	}
+	catch (const std::runtime_error&) {
+		synced = false;
+	}
+	std::lock_guard<std::mutex> lock(lock_);
+	::close(fd_);
+	fd_ = -1;
+	if (!synced){
+		throw std::runtime_error("close: log write failed");
+	}
+}
+
+/**
+* Queues a record and returns its sequence number, for sync().
+*/
+inline uint64_t WriteAheadLog::append(const void* data, std::size_t size)
+{
+	uint32_t header[2] = { static_cast<uint32_t>(size), walRecordChecksum(static_cast<uint32_t>(size), static_cast<const char*>(data)) };
+	std::lock_guard<std::mutex> lock(lock_);
+	if (fd_ < 0){
+		throw std::runtime_error("append: log is not open");
+	}
+	const char* headerBytes = reinterpret_cast<const char*>(header);
+	pending_.insert(pending_.end(), headerBytes, headerBytes + WAL_RECORD_HEADER);
+	pending_.insert(pending_.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+	return ++appended_;
+}
+
+/**
+* Returns once every record up to sequence is on disk, leading a group
+* sync if no other thread is (see the class comment). Throws
+* std::runtime_error if the log could not be written; later calls then
+* fail too, since records may be missing from the file.
+*/
+inline void WriteAheadLog::sync(uint64_t sequence)
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	while (durable_ < sequence){
+		if (failed_){
+			throw std::runtime_error("sync: log write failed");
+		}
+		if (leader_){
+			synced_.wait(lock);
+			continue;
+		}
+		leader_ = true;
+		uint64_t batchEnd = appended_;
+		flushing_.swap(pending_);
+		lock.unlock();
+		bool written = writeAll(fd_, flushing_) && fdatasync(fd_) == 0;
+		flushing_.clear();
+		lock.lock();
+		leader_ = false;
+		if (written){
+			durable_ = batchEnd;
+			++syncs_;
+		}
+		else{
+			failed_ = true;
+		}
+		synced_.notify_all();
+	}
+}
+
+/**
+* Drops every record, once all appended so far are on disk; e.g. after a
+* snapshot has captured their effect. The caller must keep new records
+* from being appended meanwhile.
+*/
+inline void WriteAheadLog::truncate()
+{
+	uint64_t last;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		last = appended_;
+	}
+	sync(last);
+	std::lock_guard<std::mutex> lock(lock_);
+	if (ftruncate(fd_, 0) != 0 || fdatasync(fd_) != 0){
+		failed_ = true;
+		throw std::runtime_error("truncate: cannot truncate log");
+	}
+}
+
+/**
+* Calls apply on the payload of each complete record in the log at path,
+* in order, and returns how many there were. A missing file holds no
+* records. Replay stops at the first record cut short or failing its
+* checksum, as a crash mid-append leaves, and cuts that tail off the
+* file so records appended later are not lost behind it.
+*/
+inline std::size_t WriteAheadLog::replay(const std::string& path, const std::function<void(const char*, std::size_t)>& apply)
+{
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in){
+		return 0;
+	}
+	std::vector<char> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	in.close();
+
+	std::size_t count = 0;
+	std::size_t offset = 0;
+	while (bytes.size() - offset >= WAL_RECORD_HEADER){
+		uint32_t header[2];
+		std::memcpy(header, &bytes[offset], WAL_RECORD_HEADER);
+		const char* payload = &bytes[offset] + WAL_RECORD_HEADER;
+		if (bytes.size() - offset - WAL_RECORD_HEADER < header[0] || walRecordChecksum(header[0], payload) != header[1]){
+			break;
+		}
+		apply(payload, header[0]);
+		offset += WAL_RECORD_HEADER + header[0];
+		++count;
+	}
+	if (offset < bytes.size() && ::truncate(path.c_str(), offset) != 0){
+		throw std::runtime_error("replay: cannot cut the torn tail off " + path);
+	}
+	return count;
+}
+
+inline uint64_t WriteAheadLog::records() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return appended_;
+}
+
+inline uint64_t WriteAheadLog::syncs() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return syncs_;
+}
+
+inline bool WriteAheadLog::writeAll(int fd, const std::vector<char>& bytes)
+{
+	std::size_t done = 0;
+	while (done < bytes.size()){
+		ssize_t n = ::write(fd, &bytes[done], bytes.size() - done);
+		if (n < 0 && errno == EINTR){
+			continue;
+		}
+		if (n <= 0){
+			return false;
+		}
+		done += n;
+	}
+	return true;
+}
+
+#endif